@@ -1,12 +1,14 @@
 package com.gzozulin.examples
 
-import com.gzozulin.ed.EdRecipe
-import com.gzozulin.ed.edRecipeCheck
-import com.gzozulin.ed.edRecipeUse
 import com.gzozulin.minigl.api.*
 import com.gzozulin.minigl.capture.Capturer
 import com.gzozulin.minigl.scene.ControllerFirstPerson
 import com.gzozulin.minigl.scene.ControllerScenic
+import com.gzozulin.minigl.scene.SdfOp
+import com.gzozulin.minigl.scene.SdfOpType
+import com.gzozulin.minigl.scene.SdfPrim
+import com.gzozulin.minigl.scene.SdfProgram
+import com.gzozulin.minigl.scene.SdfShape
 import com.gzozulin.minigl.scene.WasdInput
 import com.gzozulin.minigl.tech.ShadingFlat
 import com.gzozulin.minigl.tech.glShadingFlatDraw
@@ -33,40 +35,45 @@ private val controller = ControllerScenic(
 private val unifPos = unifv3()
 private val unifCenter = unifv3()
 
-private var shadingFlat = ShadingFlat()
-private val recipe = EdRecipe("/home/greg/blaster/assets/recipes/raymarcher", emptyMap()) {
-        isReloaded, heap, callback ->
-    if (isReloaded) {
-        @Suppress("UNCHECKED_CAST")
-        shadingFlat = ShadingFlat(
-            color = raymarcher(
-                unifPos, unifCenter, namedTexCoordsV2(), fovyf(), aspectf(window), whf(window),
-                heap["samplesAA"] as Expression<Int>,
-                heap["cylALen"] as Expression<Float>,
-                heap["cylARad"] as Expression<Float>,
-                heap["cylAMat"] as Expression<mat4>,
-                heap["coneBShape"] as Expression<vec2>,
-                heap["coneBHeight"] as Expression<Float>,
-                heap["coneBMat"] as Expression<mat4>,
-                heap["cylCLen"] as Expression<Float>,
-                heap["cylCRad"] as Expression<Float>,
-                heap["cylCMat"] as Expression<mat4>,
-                heap["boxDShape"] as Expression<vec3>,
-                heap["boxDMat"] as Expression<mat4>,
-                heap["boxEShape"] as Expression<vec3>,
-                heap["boxEMat"] as Expression<mat4>,
-                heap["prismFShape"] as Expression<vec2>,
-                heap["prismFMat"] as Expression<mat4>,
-                heap["cylGLen"] as Expression<Float>,
-                heap["cylGRad"] as Expression<Float>,
-                heap["cylGMat"] as Expression<mat4>,
-                heap["boxHShape"] as Expression<vec3>,
-                heap["boxHMat"] as Expression<mat4>
-            )
-        )
-    }
-    glShadingFlatUse(shadingFlat, callback)
-}
+private const val PI_HALF = 3.1415f / 2f
+private const val PI_QUAT = PI_HALF / 2f
+
+private val axisX = vec3(1f, 0f, 0f)
+private val axisY = vec3(0f, 1f, 0f)
+
+// world to local, the same scene sdfLoadScene builds from assets/recipes/raymarcher on the host
+private val sdfProgram = SdfProgram(
+    prims = listOf(
+        SdfPrim(SdfShape.CYLINDER,  vec4(5f, 3.5f, 0f, 0f),       mat4()),
+        SdfPrim(SdfShape.CONE,      vec4(8f, 8f, 4f, 0f),         mat4().rotate(-PI_HALF, axisX).translate(0f, 0f, -1f)),
+        SdfPrim(SdfShape.CYLINDER,  vec4(3.5f, 4f, 0f, 0f),       mat4().translate(0f, 0f, 0.2f)),
+        SdfPrim(SdfShape.BOX,       vec4(5f, 5f, 4f, 0f),         mat4().translate(0f, 0f, -6f)),
+        SdfPrim(SdfShape.BOX,       vec4(8f, 4.5f, 3.9f, 0f),     mat4().translate(0f, 0f, -6f)),
+        SdfPrim(SdfShape.PRISM,     vec4(2f, 5f, 0f, 0f),         mat4().rotate(-PI_HALF, axisY).translate(0f, -4.5f, -6f)),
+        SdfPrim(SdfShape.CYLINDER,  vec4(9f, 3f, 0f, 0f),         mat4().rotate(-PI_HALF, axisX).translate(-7f, 0f, -5.5f)),
+        SdfPrim(SdfShape.BOX,       vec4(10f, 10f, 2f, 0f),       mat4().rotate(-PI_QUAT, axisY).translate(-11.5f, -5f, -8f))
+    ),
+    // H - (((((B - A) + C) + D) + E) + F) + G)
+    ops = listOf(
+        SdfOp(SdfOpType.PRIM, 7),
+        SdfOp(SdfOpType.PRIM, 1),
+        SdfOp(SdfOpType.PRIM, 0),
+        SdfOp(SdfOpType.SUBTRACTION),
+        SdfOp(SdfOpType.PRIM, 2),
+        SdfOp(SdfOpType.UNION),
+        SdfOp(SdfOpType.PRIM, 3),
+        SdfOp(SdfOpType.UNION),
+        SdfOp(SdfOpType.PRIM, 4),
+        SdfOp(SdfOpType.UNION),
+        SdfOp(SdfOpType.PRIM, 5),
+        SdfOp(SdfOpType.UNION),
+        SdfOp(SdfOpType.PRIM, 6),
+        SdfOp(SdfOpType.UNION),
+        SdfOp(SdfOpType.SUBTRACTION)
+    ))
+
+private val shadingFlat = ShadingFlat(
+    color = raymarcherSdf(unifPos, unifCenter, namedTexCoordsV2(), fovyf(), aspectf(window), whf(window), consti(1)))
 
 private val rect = glMeshCreateRect()
 
@@ -85,15 +92,14 @@ fun main() = window.create {
         wasdInput.onKeyPressed(key, pressed)
     }*/
     glMeshUse(rect) {
-        edRecipeUse(window, recipe) {
+        glShadingFlatUse(shadingFlat) {
             //capturer.capture {
                 window.show {
-                    edRecipeCheck(recipe)
                     controller.apply { position, direction ->
                         unifPos.value = position
                         unifCenter.value = vec3(position).add(direction)
                     }
-                    glShadingFlatDraw(shadingFlat) {
+                    glShadingFlatDraw(shadingFlat, sdfProgram) {
                         glShadingFlatInstance(shadingFlat, rect)
                     }
                     //capturer.addFrame()
@@ -12,9 +12,10 @@ private val constWH = constv2i(window.width, window.height)
 private var isSimulating = false
 
 private var currentBuffer = 0
-private val buffer0 = TechniqueRtt(window, internalFormat = backend.GL_RGBA32F, minFilter = backend.GL_LINEAR) // non-normalized, linear
-private val buffer1 = TechniqueRtt(window, internalFormat= backend.GL_RGBA32F, minFilter = backend.GL_LINEAR)// non-normalized, linear
-private val deltas = TechniqueRtt(window, internalFormat= backend.GL_RGBA32F, minFilter = backend.GL_LINEAR)// non-normalized, linear
+// a packed cell per texel (see sandPack), exact in a half float - nearest, the cells do not blend
+private val buffer0 = TechniqueRtt(window, internalFormat = backend.GL_R16F, minFilter = backend.GL_NEAREST, magFilter = backend.GL_NEAREST)
+private val buffer1 = TechniqueRtt(window, internalFormat = backend.GL_R16F, minFilter = backend.GL_NEAREST, magFilter = backend.GL_NEAREST)
+private val deltas = TechniqueRtt(window, internalFormat = backend.GL_R16F, minFilter = backend.GL_NEAREST, magFilter = backend.GL_NEAREST)
 
 private val rect = glMeshCreateRect()
 private val startTexture = libTextureCreate("textures/sandsim.png")
@@ -23,8 +24,9 @@ private val sandPopulate = ShadingFlat(constm4(mat4().orthoBox()),
     sandConvert(sampler(unifs(startTexture))))
 
 private val physicsIn = unifs()
+private val physicsFrame = unifi()
 private val sandPhysics = ShadingFlat(constm4(mat4().orthoBox()),
-    sandPhysics(physicsIn, namedTexCoordsV2(), constWH))
+    sandPhysics(physicsIn, namedTexCoordsV2(), constWH, physicsFrame))
 
 private val solverOrigin = unifs()
 private val solverDeltas = unifs()
@@ -107,6 +109,7 @@ private fun sandPhysics(from: GlTexture) {
         glTextureBind(from) {
             glShadingFlatDraw(sandPhysics) {
                 physicsIn.value = from
+                physicsFrame.value = currentBuffer
                 glShadingFlatInstance(sandPhysics, rect)
             }
         }
@@ -43,6 +43,7 @@ class GlBackend {
     val GL_DEPTH_COMPONENT24:  Int get() = GL14.GL_DEPTH_COMPONENT24
     val GL_DEPTH_COMPONENT32:  Int get() = GL14.GL_DEPTH_COMPONENT32
     val GL_R32F:                Int get() = GL30C.GL_R32F
+    val GL_R16F:               Int get() = GL30C.GL_R16F
     val GL_RED:                Int get() = GL11.GL_RED
     val GL_R32UI:              Int get() = ARBTextureRG.GL_R32UI
     val GL_R32I:               Int get() = ARBTextureRG.GL_R32I
@@ -10,10 +10,14 @@ const val GL_FRAG_COORD = "gl_FragCoord.xy"
 
 const val MAX_LIGHTS        = 128
 const val MAX_BVH           = 512
+const val BVH_STACK         = 64
 const val MAX_SPHERES       = 256
 const val MAX_LAMBERTIANS   = 16
 const val MAX_METALLICS     = 16
 const val MAX_DIELECTRICS   = 16
+const val MAX_SDF_PRIMS     = 32
+const val MAX_SDF_OPS       = 64
+const val SDF_STACK         = 16
 
 private const val CUSTOM_DEF = """
     #define FLT_MAX 3.402823466e+38
@@ -29,6 +33,31 @@ private const val CUSTOM_DEF = """
     #define MATERIAL_METALIIC        1
     #define MATERIAL_DIELECTRIC      2
     
+    #define SDF_SPHERE               0
+    #define SDF_BOX                  1
+    #define SDF_CYLINDER             2
+    #define SDF_CONE                 3
+    #define SDF_PRISM                4
+    #define SDF_PLANE                5
+    #define SDF_TORUS                6
+    #define SDF_CAPSULE              7
+    #define SDF_ROUND_BOX            8
+    #define SDF_ELLIPSOID            9
+    
+    #define SDF_OP_PRIM                0
+    #define SDF_OP_UNION               1
+    #define SDF_OP_SUBTRACTION         2
+    #define SDF_OP_INTERSECTION        3
+    #define SDF_OP_SMOOTH_UNION        4
+    #define SDF_OP_SMOOTH_SUBTRACTION  5
+    #define SDF_OP_SMOOTH_INTERSECTION 6
+    
+    #define MARCH_PLAIN              0
+    #define MARCH_RELAXED            1
+    
+    #define SHADOW_HARD              0
+    #define SHADOW_SOFT              1
+    
     bool errorFlag = false;
     
     uniform int uLightsPointCnt;
@@ -36,9 +65,14 @@ private const val CUSTOM_DEF = """
     uniform Light uLights[$MAX_LIGHTS];
     
     #define MAX_BVH $MAX_BVH
+    #define BVH_STACK $BVH_STACK
     uniform BvhNode uBvhNodes[$MAX_BVH];
-    int bvhStack[$MAX_BVH];
-    int bvhTop = 0;
+    
+    // the host build traces its wide tree here instead, see bvh.c
+    HitRecord rayHitBvh(ray ray, float tMin, float tMax, int index);
+    HitRecord rayHitWorld(ray ray, float tMin, float tMax) {
+        return rayHitBvh(ray, tMin, tMax, 0);
+    }
     
     uniform Sphere                 uSpheres[$MAX_SPHERES];
     
@@ -46,6 +80,13 @@ private const val CUSTOM_DEF = """
     uniform MetallicMaterial       uMetallicMaterials  [$MAX_METALLICS];
     uniform DielectricMaterial     uDielectricMaterials[$MAX_DIELECTRICS];
     
+    #define MAX_SDF_PRIMS $MAX_SDF_PRIMS
+    #define MAX_SDF_OPS $MAX_SDF_OPS
+    #define SDF_STACK $SDF_STACK
+    uniform SdfPrim uSdfPrims[$MAX_SDF_PRIMS];
+    uniform SdfOp uSdfOps[$MAX_SDF_OPS];
+    uniform int uSdfOpsCnt;
+    
     float error() { return 0.0f; } // nothing
 """
 
@@ -292,6 +333,15 @@ private const val CUSTOM_MAT4_DEF = """
         return mat * vec;
     }
     
+    vec3 affinev3(vec3 vec, mat4 mat) {
+        return mat3(mat) * vec + mat[3].xyz;
+    }
+    
+    mat4 inversem4Affine(mat4 mat) {
+        mat3 inv = inverse(mat3(mat));
+        return mat4(vec4(inv[0], 0.0), vec4(inv[1], 0.0), vec4(inv[2], 0.0), vec4(-(inv * mat[3].xyz), 1.0));
+    }
+    
     mat4 translatem4(vec3 vec) {
         return mat4(1.0, 0.0, 0.0, 0.0,  0.0, 1.0, 0.0, 0.0,  0.0, 0.0, 1.0, 0.0,  vec.x, vec.y, vec.z, 1.0);
     }
@@ -16,6 +16,9 @@ private const val DEF_DIELECTRICMATERIAL = "struct DielectricMaterial {  float r
 private const val DEF_HITRECORD = "struct HitRecord {  float t ; vec3 point ; vec3 normal ; int materialType ; int materialIndex ;  };\n"
 private const val DEF_SCATTERRESULT = "struct ScatterResult {  vec3 attenuation ; ray scattered ;  };\n"
 private const val DEF_REFRACTRESULT = "struct RefractResult {  bool isRefracted ; vec3 refracted ;  };\n"
+private const val DEF_MARCHRESULT = "struct MarchResult {  float t ; int steps ;  };\n"
+private const val DEF_SDFPRIM = "struct SdfPrim {  int type ; vec4 params ; mat4 transform ; vec4 repeat ; vec4 limit ; vec2 displace ; float lipschitz ;  };\n"
+private const val DEF_SDFOP = "struct SdfOp {  int op ; int index ; float blend ; vec4 bounds ; int polarity ; int outer ; int inner ;  };\n"
 private const val DEF_ADDF = "float addf ( float left , float right ) { return left + right ; }\n"
 private const val DEF_SUBF = "float subf ( float left , float right ) { return left - right ; }\n"
 private const val DEF_MULF = "float mulf ( float left , float right ) { return left * right ; }\n"
@@ -89,7 +92,7 @@ private const val DEF_SUBV4 = "vec4 subv4 ( vec4 left , vec4 right ) { return v4
 private const val DEF_MULV4 = "vec4 mulv4 ( vec4 left , vec4 right ) { return v4 ( left . x * right . x , left . y * right . y , left . z * right . z , left . w * right . w ) ; }\n"
 private const val DEF_MULV4F = "vec4 mulv4f ( vec4 left , float right ) { return v4 ( left . x * right , left . y * right , left . z * right , left . w * right ) ; }\n"
 private const val DEF_DIVV4 = "vec4 divv4 ( vec4 left , vec4 right ) { return v4 ( left . x / right . x , left . y / right . y , left . z / right . z , left . w / right . w ) ; }\n"
-private const val DEF_DIVV4F = "vec4 divv4f ( vec4 left , float right ) { return v4 ( left . x / right , left . y / right , left . z / right , left . z / right ) ; }\n"
+private const val DEF_DIVV4F = "vec4 divv4f ( vec4 left , float right ) { return v4 ( left . x / right , left . y / right , left . z / right , left . w / right ) ; }\n"
 private const val DEF_GETXV4 = "float getxv4 ( vec4 v ) { return v . x ; }\n"
 private const val DEF_GETYV4 = "float getyv4 ( vec4 v ) { return v . y ; }\n"
 private const val DEF_GETZV4 = "float getzv4 ( vec4 v ) { return v . z ; }\n"
@@ -123,9 +126,20 @@ private const val DEF_SDCAPPEDCYLINDER = "float sdCappedCylinder ( vec3 p , vec3
 private const val DEF_SDSIMPLIFIEDCYL = "float sdSimplifiedCyl ( vec3 p , float cylLen , float cylRad ) { return sdCappedCylinder ( p , v3 ( 0 , 0 , cylLen / 2.0f ) , v3 ( 0 , 0 , - cylLen / 2.0f ) , cylRad ) ; }\n"
 private const val DEF_SDCONE = "float sdCone ( vec3 p , vec2 c , float h ) { vec2 q = mulv2f ( v2 ( c . x / c . y , - 1.0f ) , h ) ; vec2 w = v2 ( lenv2 ( xzv3 ( p ) ) , p . y ) ; vec2 a = subv2 ( w , mulv2f ( q , clampf ( dotv2 ( w , q ) / dotv2 ( q , q ) , 0.0f , 1.0f ) ) ) ; vec2 b = subv2 ( w , mulv2 ( q , v2 ( clampf ( w . x / q . x , 0.0f , 1.0f ) , 1.0f ) ) ) ; float k = signf ( q . y ) ; float d = minf ( dotv2 ( a , a ) , dotv2 ( b , b ) ) ; float s = maxf ( k * ( w . x * q . y - w . y * q . x ) , k * ( w . y - q . y ) ) ; return sqrtf ( d ) * signf ( s ) ; }\n"
 private const val DEF_SDTRIPRISM = "float sdTriPrism ( vec3 p , vec2 h ) { vec3 q = absv3 ( p ) ; return maxf ( q . z - h . y , maxf ( q . x * 0.866025f + p . y * 0.5f , - p . y ) - h . x * 0.5f ) ; }\n"
+private const val DEF_SDTORUS = "float sdTorus ( vec3 p , vec2 t ) { vec2 q = v2 ( lenv2 ( xzv3 ( p ) ) - t . x , p . y ) ; return lenv2 ( q ) - t . y ; }\n"
+private const val DEF_SDCAPSULE = "float sdCapsule ( vec3 p , vec3 a , vec3 b , float r ) { vec3 pa = subv3 ( p , a ) ; vec3 ba = subv3 ( b , a ) ; float h = clampf ( dotv3 ( pa , ba ) / dotv3 ( ba , ba ) , 0.0f , 1.0f ) ; return lenv3 ( subv3 ( pa , mulv3f ( ba , h ) ) ) - r ; }\n"
+private const val DEF_SDROUNDBOX = "float sdRoundBox ( vec3 p , vec3 b , float r ) { return sdBox ( p , subv3f ( b , r ) ) - r ; }\n"
+private const val DEF_SDELLIPSOID = "float sdEllipsoid ( vec3 p , vec3 r ) { float k = lenv3 ( divv3 ( p , r ) ) ; return ( k - 1.0f ) * minf ( r . x , minf ( r . y , r . z ) ) ; }\n"
 private const val DEF_OPUNION = "float opUnion ( float d1 , float d2 ) { return minf ( d1 , d2 ) ; }\n"
 private const val DEF_OPSUBTRACTION = "float opSubtraction ( float d1 , float d2 ) { return maxf ( - d1 , d2 ) ; }\n"
 private const val DEF_OPINTERSECTION = "float opIntersection ( float d1 , float d2 ) { return maxf ( d1 , d2 ) ; }\n"
+private const val DEF_OPSMOOTHUNION = "float opSmoothUnion ( float d1 , float d2 , float k ) { float h = maxf ( k - absf ( d1 - d2 ) , 0.0f ) / k ; return minf ( d1 , d2 ) - h * h * k * 0.25f ; }\n"
+private const val DEF_OPSMOOTHSUBTRACTION = "float opSmoothSubtraction ( float d1 , float d2 , float k ) { return - opSmoothUnion ( d1 , - d2 , k ) ; }\n"
+private const val DEF_OPSMOOTHINTERSECTION = "float opSmoothIntersection ( float d1 , float d2 , float k ) { return - opSmoothUnion ( - d1 , - d2 , k ) ; }\n"
+private const val DEF_OPREPAXIS = "float opRepAxis ( float p , float c , float l ) { if ( c == 0.0f ) { return p ; } float id = floorf ( p / c + 0.5f ) ; if ( l > 0.0f ) { id = clampf ( id , - l , l ) ; } return p - c * id ; }\n"
+private const val DEF_OPREP = "vec3 opRep ( vec3 p , vec3 c ) { return v3 ( opRepAxis ( p . x , c . x , 0.0f ) , opRepAxis ( p . y , c . y , 0.0f ) , opRepAxis ( p . z , c . z , 0.0f ) ) ; }\n"
+private const val DEF_OPREPLIM = "vec3 opRepLim ( vec3 p , vec3 c , vec3 l ) { return v3 ( opRepAxis ( p . x , c . x , l . x ) , opRepAxis ( p . y , c . y , l . y ) , opRepAxis ( p . z , c . z , l . z ) ) ; }\n"
+private const val DEF_OPDISPLACE = "float opDisplace ( vec3 p , float d , vec2 displace ) { vec3 f = mulv3f ( p , displace . y ) ; return d + displace . x * sinf ( f . x ) * sinf ( f . y ) * sinf ( f . z ) ; }\n"
 private const val DEF_RANDOMINUNITSPHERE = "vec3 randomInUnitSphere ( ) { vec3 result ; for ( int i = 0 ; i < 10 ; i ++ ) { result = v3 ( seededRndf ( ) * 2.0f - 1.0f , seededRndf ( ) * 2.0f - 1.0f , seededRndf ( ) * 2.0f - 1.0f ) ; if ( lensqv3 ( result ) >= 1.0f ) { return result ; } } return normv3 ( result ) ; }\n"
 private const val DEF_RANDOMINUNITDISK = "vec3 randomInUnitDisk ( ) { vec3 result ; for ( int i = 0 ; i < 10 ; i ++ ) { result = subv3 ( mulv3f ( v3 ( seededRndf ( ) , seededRndf ( ) , 0.0f ) , 2.0f ) , v3 ( 1.0f , 1.0f , 0.0f ) ) ; if ( dotv3 ( result , result ) >= 1.0f ) { return result ; } } return normv3 ( result ) ; }\n"
 private const val DEF_CENTERUV = "vec2 centerUV ( vec2 uv , float aspect ) { vec2 center = subv2f ( uv , 0.5f ) ; return v2 ( center . x * aspect , center . y ) ; }\n"
@@ -141,8 +155,7 @@ private const val DEF_RAYHITAABB = "bool rayHitAabb ( ray ray , aabb aabb , floa
 private const val DEF_RAYHITSPHERERECORD = "HitRecord rayHitSphereRecord ( ray ray , float t , Sphere sphere ) { vec3 point = rayPoint ( ray , t ) ; vec3 N = normv3 ( divv3f ( subv3 ( point , sphere . center ) , sphere . radius ) ) ; HitRecord result = { t , point , N , sphere . materialType , sphere . materialIndex } ; return result ; }\n"
 private const val DEF_RAYHITSPHERE = "HitRecord rayHitSphere ( ray ray , float tMin , float tMax , Sphere sphere ) { vec3 oc = subv3 ( ray . origin , sphere . center ) ; float a = dotv3 ( ray . direction , ray . direction ) ; float b = 2 * dotv3 ( oc , ray . direction ) ; float c = dotv3 ( oc , oc ) - sphere . radius * sphere . radius ; float D = b * b - 4 * a * c ; if ( D > 0 ) { float t = ( - b - sqrtf ( D ) ) / 2 * a ; if ( t < tMax && t > tMin ) { return rayHitSphereRecord ( ray , t , sphere ) ; } t = ( - b + sqrtf ( D ) ) / 2 * a ; if ( t < tMax && t > tMin ) { return rayHitSphereRecord ( ray , t , sphere ) ; } } return NO_HIT ; }\n"
 private const val DEF_RAYHITOBJECT = "HitRecord rayHitObject ( ray ray , float tMin , float tMax , int type , int index ) { if ( type != HITABLE_SPHERE ) { error ( ) ; return NO_HIT ; } return rayHitSphere ( ray , tMin , tMax , uSpheres [ index ] ) ; }\n"
-private const val DEF_RAYHITBVH = "HitRecord rayHitBvh ( ray ray , float tMin , float tMax , int index ) { bvhTop = 0 ; float closest = tMax ; HitRecord result = NO_HIT ; int curr = index ; while ( curr >= 0 ) { while ( curr >= 0 && rayHitAabb ( ray , uBvhNodes [ curr ] . aabb , tMin , closest ) ) { if ( uBvhNodes [ curr ] . leftType == HITABLE_BVH ) { bvhStack [ bvhTop ] = curr ; bvhTop ++ ; curr = uBvhNodes [ curr ] . leftIndex ; } else { HitRecord hit = rayHitObject ( ray , tMin , closest , uBvhNodes [ curr ] . leftType , uBvhNodes [ curr ] . leftIndex ) ; if ( hit . t > 0 && hit . t < closest ) { result = hit ; closest = hit . t ; } break ; } } bvhTop -- ; if ( bvhTop < 0 ) { break ; } curr = bvhStack [ bvhTop ] ; curr = uBvhNodes [ curr ] . rightIndex ; } return result ; }\n"
-private const val DEF_RAYHITWORLD = "HitRecord rayHitWorld ( ray ray , float tMin , float tMax ) { return rayHitBvh ( ray , tMin , tMax , 0 ) ; }\n"
+private const val DEF_RAYHITBVH = "HitRecord rayHitBvh ( ray ray , float tMin , float tMax , int index ) { int bvhStack [ BVH_STACK ] ; int bvhTop = 0 ; float closest = tMax ; HitRecord result = NO_HIT ; int curr = index ; while ( curr >= 0 ) { while ( curr >= 0 && rayHitAabb ( ray , uBvhNodes [ curr ] . aabb , tMin , closest ) ) { if ( uBvhNodes [ curr ] . leftType == HITABLE_BVH ) { bvhStack [ bvhTop ] = curr ; bvhTop ++ ; curr = uBvhNodes [ curr ] . leftIndex ; } else { HitRecord hit = rayHitObject ( ray , tMin , closest , uBvhNodes [ curr ] . leftType , uBvhNodes [ curr ] . leftIndex ) ; if ( hit . t > 0 && hit . t < closest ) { result = hit ; closest = hit . t ; } break ; } } bvhTop -- ; if ( bvhTop < 0 ) { break ; } curr = bvhStack [ bvhTop ] ; curr = uBvhNodes [ curr ] . rightIndex ; } return result ; }\n"
 private const val DEF_SCATTERLAMBERTIAN = "ScatterResult scatterLambertian ( HitRecord record , LambertianMaterial material ) { vec3 tangent = addv3 ( record . point , record . normal ) ; vec3 direction = addv3 ( tangent , randomInUnitSphere ( ) ) ; ScatterResult result = { material . albedo , { record . point , subv3 ( direction , record . point ) } } ; return result ; }\n"
 private const val DEF_SCATTERMETALLIC = "ScatterResult scatterMetallic ( ray ray , HitRecord record , MetallicMaterial material ) { vec3 reflected = reflectv3 ( ray . direction , record . normal ) ; if ( dotv3 ( reflected , record . normal ) > 0 ) { ScatterResult result = { material . albedo , { record . point , reflected } } ; return result ; } else { return NO_SCATTER ; } }\n"
 private const val DEF_SCATTERDIELECTRIC = "ScatterResult scatterDielectric ( ray ray , HitRecord record , DielectricMaterial material ) { float niOverNt ; float cosine ; vec3 outwardNormal ; float rdotn = dotv3 ( ray . direction , record . normal ) ; float dirlen = lenv3 ( ray . direction ) ; if ( rdotn > 0 ) { outwardNormal = negv3 ( record . normal ) ; niOverNt = material . reflectiveIndex ; cosine = material . reflectiveIndex * rdotn / dirlen ; } else { outwardNormal = record . normal ; niOverNt = 1.0f / material . reflectiveIndex ; cosine = - rdotn / dirlen ; } float reflectProbe ; RefractResult refractResult = refractv3 ( ray . direction , outwardNormal , niOverNt ) ; if ( refractResult . isRefracted ) { reflectProbe = schlickf ( cosine , material . reflectiveIndex ) ; } else { reflectProbe = 1.0f ; } vec3 scatteredDir ; if ( seededRndf ( ) < reflectProbe ) { scatteredDir = reflectv3 ( ray . direction , record . normal ) ; } else { scatteredDir = refractResult . refracted ; } ScatterResult scatterResult = { v3one ( ) , { record . point , scatteredDir } } ; return scatterResult ; }\n"
@@ -167,29 +180,65 @@ private const val DEF_SHADINGPBR = "vec4 shadingPbr ( vec3 eye , vec3 worldPos ,
 private const val DEF_TYPE_EMPTY = "int TYPE_EMPTY = 0 ;\n"
 private const val DEF_TYPE_SAND = "int TYPE_SAND = 1 ;\n"
 private const val DEF_TYPE_WATER = "int TYPE_WATER = 2 ;\n"
-private const val DEF_SANDCONVERT = "vec4 sandConvert ( vec4 pixel ) { if ( pixel . x > 0.9f && pixel . y > 0.9f ) { return v4 ( itof ( TYPE_SAND ) , 0.0f , 0.0f , pixel . x ) ; } if ( pixel . z > 0.9f ) { return v4 ( itof ( TYPE_WATER ) , 0.0f , 0.0f , pixel . x ) ; } else { return v4zero ( ) ; } }\n"
+private const val DEF_TYPE_WALL = "int TYPE_WALL = 3 ;\n"
+private const val DEF_SANDPACK = "int sandPack ( int type , ivec2 move , int seed ) { int dir = ( move . x + 3 ) % 3 + ( ( move . y + 3 ) % 3 ) * 3 ; return type + dir * 4 + seed * 64 ; }\n"
+private const val DEF_SANDTYPE = "int sandType ( int cell ) { return cell % 4 ; }\n"
+private const val DEF_SANDMOVE = "ivec2 sandMove ( int cell ) { int dir = ( cell / 4 ) % 16 ; int x = dir % 3 ; int y = dir / 3 ; return iv2 ( x == 2 ? - 1 : x , y == 2 ? - 1 : y ) ; }\n"
+private const val DEF_SANDSEED = "int sandSeed ( int cell ) { return cell / 64 ; }\n"
+private const val DEF_SANDCELLAT = "int sandCellAt ( sampler2D orig , vec2 uv ) { return ftoi ( sampler ( orig , uv ) . x ) ; }\n"
+private const val DEF_SANDCONVERT = "vec4 sandConvert ( vec4 pixel ) { int seed = ftoi ( pixel . z * 255.0f ) % 4 ; if ( pixel . x > 0.9f && pixel . y > 0.9f ) { return v4 ( itof ( sandPack ( TYPE_SAND , iv2zero ( ) , seed ) ) , 0.0f , 0.0f , 0.0f ) ; } if ( pixel . z > 0.9f ) { return v4 ( itof ( sandPack ( TYPE_WATER , iv2zero ( ) , seed ) ) , 0.0f , 0.0f , 0.0f ) ; } else { return v4zero ( ) ; } }\n"
+private const val DEF_SANDRND = "float sandRnd ( ivec2 cell , int frame , int material ) { return rndv3 ( v3 ( itof ( cell . x ) , itof ( cell . y ) , itof ( frame * 4 + material ) ) ) ; }\n"
 private const val DEF_NEARBYCELLCOORDS = "vec2 nearbyCellCoords ( vec2 uv , float cellW , float cellH , int x , int y ) { return v2 ( uv . x + itof ( x ) * cellW , uv . y + itof ( y ) * cellH ) ; }\n"
-private const val DEF_TRYDEPOSITPARTICLE = "ivec2 tryDepositParticle ( sampler2D orig , vec2 uv , float cellW , float cellH , int x , int y ) { vec2 coords = nearbyCellCoords ( uv , cellW , cellH , x , y ) ; if ( coords . x < 0.0f || coords . y < 0.0f || coords . x > 1.0f || coords . y > 1.0f ) { return iv2zero ( ) ; } vec4 cell = sampler ( orig , coords ) ; if ( ftoi ( cell . x ) == TYPE_EMPTY ) { return iv2 ( x , y ) ; } return iv2zero ( ) ; }\n"
-private const val DEF_SIMTYPESAND = "ivec2 simTypeSand ( sampler2D orig , vec2 uv , float cellW , float cellH ) { ivec2 deposit = tryDepositParticle ( orig , uv , cellW , cellH , 0 , - 1 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } bool left = rndv2 ( uv ) > 0.5f ; int first = left ? - 1 : 1 ; int second = left ? 1 : - 1 ; deposit = tryDepositParticle ( orig , uv , cellW , cellH , first , - 1 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } deposit = tryDepositParticle ( orig , uv , cellW , cellH , second , - 1 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } return iv2zero ( ) ; }\n"
-private const val DEF_SIMTYPEWATER = "ivec2 simTypeWater ( sampler2D orig , vec2 uv , float cellW , float cellH ) { ivec2 deposit = simTypeSand ( orig , uv , cellW , cellH ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } bool left = rndv3 ( v2tov3 ( uv , itof ( TYPE_WATER ) ) ) > 0.5f ; int first = left ? - 1 : 1 ; int second = left ? 1 : - 1 ; deposit = tryDepositParticle ( orig , uv , cellW , cellH , first , 0 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } deposit = tryDepositParticle ( orig , uv , cellW , cellH , second , 0 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } return iv2zero ( ) ; }\n"
-private const val DEF_SANDPHYSICS = "vec4 sandPhysics ( sampler2D orig , vec2 uv , ivec2 wh ) { float cellW = 1.0f / itof ( wh . x ) ; float cellH = 1.0f / itof ( wh . y ) ; int type = ftoi ( sampler ( orig , uv ) . x ) ; if ( type == TYPE_SAND ) { return iv2tov4 ( simTypeSand ( orig , uv , cellW , cellH ) , 0.0f , 0.0f ) ; } if ( type == TYPE_WATER ) { return iv2tov4 ( simTypeWater ( orig , uv , cellW , cellH ) , 0.0f , 0.0f ) ; } else { return v4zero ( ) ; } }\n"
-private const val DEF_SANDSOLVER = "vec4 sandSolver ( sampler2D orig , sampler2D deltas , vec2 uv , ivec2 wh ) { float cellW = 1.0f / itof ( wh . x ) ; float cellH = 1.0f / itof ( wh . y ) ; vec4 result = v4zero ( ) ; for ( int x = - 1 ; x < 2 ; x ++ ) { for ( int y = - 1 ; y < 2 ; y ++ ) { vec2 coords = nearbyCellCoords ( uv , cellW , cellH , x , y ) ; if ( coords . x < 0.0f || coords . y < 0.0f || coords . x > 1.0f || coords . y > 1.0f ) { continue ; } vec4 cell = sampler ( orig , coords ) ; if ( ftoi ( cell . x ) == TYPE_EMPTY ) { continue ; } vec4 delta = sampler ( deltas , coords ) ; if ( delta . x == itof ( - x ) && delta . y == itof ( - y ) ) { return cell ; } } } return result ; }\n"
-private const val DEF_SANDDRAW = "vec4 sandDraw ( sampler2D orig , vec2 uv , ivec2 wh ) { float cellW = 1.0f / itof ( wh . x ) ; float cellH = 1.0f / itof ( wh . y ) ; vec3 result = v3zero ( ) ; for ( int x = - 1 ; x < 2 ; x ++ ) { for ( int y = - 1 ; y < 2 ; y ++ ) { vec2 coords = nearbyCellCoords ( uv , cellW , cellH , x , y ) ; vec4 cell = sampler ( orig , coords ) ; int type = ftoi ( cell . x ) ; if ( type == TYPE_SAND ) { result = addv3 ( result , v3yellow ( ) ) ; } if ( type == TYPE_WATER ) { result = addv3 ( result , v3blue ( ) ) ; } else { result = addv3 ( result , mulv3f ( v3cyan ( ) , coords . y ) ) ; } } } result = divv3f ( result , 9.0f ) ; return v3tov4 ( result , 1.0f ) ; }\n"
+private const val DEF_TRYDEPOSITPARTICLE = "ivec2 tryDepositParticle ( sampler2D orig , vec2 uv , float cellW , float cellH , int x , int y ) { vec2 coords = nearbyCellCoords ( uv , cellW , cellH , x , y ) ; if ( coords . x < 0.0f || coords . y < 0.0f || coords . x > 1.0f || coords . y > 1.0f ) { return iv2zero ( ) ; } if ( sandType ( sandCellAt ( orig , coords ) ) == TYPE_EMPTY ) { return iv2 ( x , y ) ; } return iv2zero ( ) ; }\n"
+private const val DEF_SIMTYPESAND = "ivec2 simTypeSand ( sampler2D orig , vec2 uv , float cellW , float cellH , float rnd ) { ivec2 deposit = tryDepositParticle ( orig , uv , cellW , cellH , 0 , - 1 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } bool left = rnd > 0.5f ; int first = left ? - 1 : 1 ; int second = left ? 1 : - 1 ; deposit = tryDepositParticle ( orig , uv , cellW , cellH , first , - 1 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } deposit = tryDepositParticle ( orig , uv , cellW , cellH , second , - 1 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } return iv2zero ( ) ; }\n"
+private const val DEF_SIMTYPEWATER = "ivec2 simTypeWater ( sampler2D orig , vec2 uv , float cellW , float cellH , float rnd ) { ivec2 deposit = simTypeSand ( orig , uv , cellW , cellH , rnd ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } bool left = rnd > 0.25f && rnd < 0.75f ; int first = left ? - 1 : 1 ; int second = left ? 1 : - 1 ; deposit = tryDepositParticle ( orig , uv , cellW , cellH , first , 0 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } deposit = tryDepositParticle ( orig , uv , cellW , cellH , second , 0 ) ; if ( ! eqiv2 ( deposit , iv2zero ( ) ) ) { return deposit ; } return iv2zero ( ) ; }\n"
+private const val DEF_SANDPHYSICS = "vec4 sandPhysics ( sampler2D orig , vec2 uv , ivec2 wh , int frame ) { float cellW = 1.0f / itof ( wh . x ) ; float cellH = 1.0f / itof ( wh . y ) ; int cell = sandCellAt ( orig , uv ) ; int type = sandType ( cell ) ; float rnd = sandRnd ( iv2 ( ftoi ( uv . x * itof ( wh . x ) ) , ftoi ( uv . y * itof ( wh . y ) ) ) , frame , type ) ; if ( type == TYPE_SAND ) { return v4 ( itof ( sandPack ( type , simTypeSand ( orig , uv , cellW , cellH , rnd ) , sandSeed ( cell ) ) ) , 0.0f , 0.0f , 0.0f ) ; } if ( type == TYPE_WATER ) { return v4 ( itof ( sandPack ( type , simTypeWater ( orig , uv , cellW , cellH , rnd ) , sandSeed ( cell ) ) ) , 0.0f , 0.0f , 0.0f ) ; } else { return v4zero ( ) ; } }\n"
+private const val DEF_SANDSOLVER = "vec4 sandSolver ( sampler2D orig , sampler2D deltas , vec2 uv , ivec2 wh ) { float cellW = 1.0f / itof ( wh . x ) ; float cellH = 1.0f / itof ( wh . y ) ; vec4 result = v4zero ( ) ; for ( int x = - 1 ; x < 2 ; x ++ ) { for ( int y = - 1 ; y < 2 ; y ++ ) { vec2 coords = nearbyCellCoords ( uv , cellW , cellH , x , y ) ; if ( coords . x < 0.0f || coords . y < 0.0f || coords . x > 1.0f || coords . y > 1.0f ) { continue ; } if ( sandType ( sandCellAt ( orig , coords ) ) == TYPE_EMPTY ) { continue ; } int delta = sandCellAt ( deltas , coords ) ; ivec2 move = sandMove ( delta ) ; if ( move . x == - x && move . y == - y ) { return v4 ( itof ( delta ) , 0.0f , 0.0f , 0.0f ) ; } } } return result ; }\n"
+private const val DEF_SANDBLOCKCELL = "int sandBlockCell ( sampler2D orig , int x , int y , ivec2 wh ) { if ( x < 0 || y < 0 || x >= wh . x || y >= wh . y ) { return TYPE_WALL ; } return sandCellAt ( orig , v2 ( ( itof ( x ) + 0.5f ) / itof ( wh . x ) , ( itof ( y ) + 0.5f ) / itof ( wh . y ) ) ) ; }\n"
+private const val DEF_SANDBLOCKMOVABLE = "bool sandBlockMovable ( int cell ) { return sandType ( cell ) == TYPE_SAND || sandType ( cell ) == TYPE_WATER ; }\n"
+private const val DEF_SANDMARGOLUS = "vec4 sandMargolus ( sampler2D orig , vec2 uv , ivec2 wh , int frame ) { int offset = frame % 2 ; int x = ftoi ( uv . x * itof ( wh . x ) ) ; int y = ftoi ( uv . y * itof ( wh . y ) ) ; int bx = ( ( x + offset ) / 2 ) * 2 - offset ; int by = ( ( y + offset ) / 2 ) * 2 - offset ; int cells [ 4 ] ; int from [ 4 ] ; for ( int i = 0 ; i < 4 ; i ++ ) { cells [ i ] = sandBlockCell ( orig , bx + i % 2 , by + i / 2 , wh ) ; from [ i ] = i ; } for ( int column = 0 ; column < 2 ; column ++ ) { if ( sandBlockMovable ( cells [ column + 2 ] ) && sandType ( cells [ column ] ) == TYPE_EMPTY ) { cells [ column ] = cells [ column + 2 ] ; from [ column ] = from [ column + 2 ] ; cells [ column + 2 ] = TYPE_EMPTY ; } } bool left = sandRnd ( iv2 ( bx , by ) , frame , TYPE_EMPTY ) > 0.5f ; for ( int i = 0 ; i < 2 ; i ++ ) { int top = ( i == 0 ) == left ? 3 : 2 ; int to = top == 3 ? 0 : 1 ; if ( sandBlockMovable ( cells [ top ] ) && sandType ( cells [ top - 2 ] ) != TYPE_EMPTY && sandType ( cells [ to ] ) == TYPE_EMPTY ) { cells [ to ] = cells [ top ] ; from [ to ] = from [ top ] ; cells [ top ] = TYPE_EMPTY ; } } for ( int top = 2 ; top < 4 ; top ++ ) { int to = top == 2 ? 3 : 2 ; if ( sandType ( cells [ top ] ) == TYPE_WATER && sandType ( cells [ top - 2 ] ) != TYPE_EMPTY && sandType ( cells [ to ] ) == TYPE_EMPTY ) { cells [ to ] = cells [ top ] ; from [ to ] = from [ top ] ; cells [ top ] = TYPE_EMPTY ; break ; } } int own = ( y - by ) * 2 + ( x - bx ) ; int cell = cells [ own ] ; if ( sandType ( cell ) == TYPE_EMPTY ) { return v4zero ( ) ; } ivec2 move = iv2 ( own % 2 - from [ own ] % 2 , own / 2 - from [ own ] / 2 ) ; return v4 ( itof ( sandPack ( sandType ( cell ) , move , sandSeed ( cell ) ) ) , 0.0f , 0.0f , 0.0f ) ; }\n"
+private const val DEF_SANDDRAW = "vec4 sandDraw ( sampler2D orig , vec2 uv , ivec2 wh ) { float cellW = 1.0f / itof ( wh . x ) ; float cellH = 1.0f / itof ( wh . y ) ; vec3 result = v3zero ( ) ; for ( int x = - 1 ; x < 2 ; x ++ ) { for ( int y = - 1 ; y < 2 ; y ++ ) { vec2 coords = nearbyCellCoords ( uv , cellW , cellH , x , y ) ; int cell = sandCellAt ( orig , coords ) ; int type = sandType ( cell ) ; if ( type == TYPE_SAND ) { result = addv3 ( result , mulv3f ( v3yellow ( ) , 1.0f - itof ( sandSeed ( cell ) ) * 0.08f ) ) ; } if ( type == TYPE_WATER ) { result = addv3 ( result , v3blue ( ) ) ; } else { result = addv3 ( result , mulv3f ( v3cyan ( ) , coords . y ) ) ; } } } result = divv3f ( result , 9.0f ) ; return v3tov4 ( result , 1.0f ) ; }\n"
 private const val DEF_MAX_STEPS = "int MAX_STEPS = 100 ;\n"
 private const val DEF_MAX_DIST = "float MAX_DIST = 100.0f ;\n"
-private const val DEF_SURF_DIST = "float SURF_DIST = 0.01f ;\n"
-private const val DEF_RAYMARCHERSCENE = "struct RaymarcherScene {  float cylALen ; float cylARad ; mat4 cylAMat ; vec2 coneBShape ; float coneBHeight ; mat4 coneBMat ; float cylCLen ; float cylCRad ; mat4 cylCMat ; vec3 boxDShape ; mat4 boxDMat ; vec3 boxEShape ; mat4 boxEMat ; vec2 prismFShape ; mat4 prismFMat ; float cylGLen ; float cylGRad ; mat4 cylGMat ; vec3 boxHShape ; mat4 boxHMat ;  };\n"
-private const val DEF_SCENEDIST = "float sceneDist ( vec3 p , RaymarcherScene scene ) { vec4 p4 = v3tov4 ( p , 1.0f ) ; vec3 cylAP = v4tov3 ( transformv4 ( p4 , scene . cylAMat ) ) ; float cylA = sdSimplifiedCyl ( cylAP , scene . cylALen , scene . cylARad ) ; vec3 coneBP = v4tov3 ( transformv4 ( p4 , scene . coneBMat ) ) ; float coneB = sdCone ( coneBP , scene . coneBShape , scene . coneBHeight ) ; vec3 cylCP = v4tov3 ( transformv4 ( p4 , scene . cylCMat ) ) ; float cylC = sdSimplifiedCyl ( cylCP , scene . cylCLen , scene . cylCRad ) ; vec3 boxDP = v4tov3 ( transformv4 ( p4 , scene . boxDMat ) ) ; float boxD = sdBox ( boxDP , scene . boxDShape ) ; vec3 boxEP = v4tov3 ( transformv4 ( p4 , scene . boxEMat ) ) ; float boxE = sdBox ( boxEP , scene . boxEShape ) ; vec3 prismFP = v4tov3 ( transformv4 ( p4 , scene . prismFMat ) ) ; float prismF = sdTriPrism ( prismFP , scene . prismFShape ) ; vec3 cylGP = v4tov3 ( transformv4 ( p4 , scene . cylGMat ) ) ; float cylG = sdSimplifiedCyl ( cylGP , scene . cylGLen , scene . cylGRad ) ; vec3 boxHP = v4tov3 ( transformv4 ( p4 , scene . boxHMat ) ) ; float boxH = sdBox ( boxHP , scene . boxHShape ) ; float AB = opSubtraction ( coneB , cylA ) ; float AC = opUnion ( AB , cylC ) ; float AD = opUnion ( AC , boxD ) ; float AE = opUnion ( AD , boxE ) ; float AF = opUnion ( AE , prismF ) ; float AG = opUnion ( AF , cylG ) ; float AH = opSubtraction ( boxH , AG ) ; return AH ; }\n"
-private const val DEF_RAYMARCH = "float rayMarch ( vec3 ro , vec3 rd , RaymarcherScene scene ) { float dO = 0.0f ; for ( int i = 0 ; i < MAX_STEPS ; i ++ ) { vec3 p = addv3 ( ro , mulv3f ( rd , dO ) ) ; float dS = sceneDist ( p , scene ) ; dO += dS ; if ( dO > MAX_DIST || dS < SURF_DIST ) break ; } return dO ; }\n"
-private const val DEF_GETNORMAL = "vec3 getNormal ( vec3 p , RaymarcherScene scene ) { float d = sceneDist ( p , scene ) ; vec3 n = subv3 ( ftov3 ( d ) , v3 ( sceneDist ( v3 ( p . x - 0.01f , p . y , p . z ) , scene ) , sceneDist ( v3 ( p . x , p . y - 0.01f , p . z ) , scene ) , sceneDist ( v3 ( p . x , p . y , p . z - 0.01f ) , scene ) ) ) ; return normv3 ( n ) ; }\n"
-private const val DEF_GETLIGHT = "float getLight ( vec3 p , vec3 eye , RaymarcherScene scene ) { vec3 l = normv3 ( subv3 ( eye , p ) ) ; vec3 n = getNormal ( p , scene ) ; float a = clampf ( dotv3 ( n , l ) , 0.0f , 1.0f ) ; float d = rayMarch ( addv3 ( p , mulv3f ( n , SURF_DIST * 2.0f ) ) , l , scene ) ; if ( d < lenv3 ( subv3 ( eye , p ) ) ) a *= 0.1f ; return a ; }\n"
-private const val DEF_RAYMARCHER = "vec4 raymarcher ( vec3 eye , vec3 center , vec2 uv , float fovy , float aspect , ivec2 wh , int samplesAA , float cylALen , float cylARad , mat4 cylAMat , vec2 coneBShape , float coneBHeight , mat4 coneBMat , float cylCLen , float cylCRad , mat4 cylCMat , vec3 boxDShape , mat4 boxDMat , vec3 boxEShape , mat4 boxEMat , vec2 prismFShape , mat4 prismFMat , float cylGLen , float cylGRad , mat4 cylGMat , vec3 boxHShape , mat4 boxHMat ) { RaymarcherScene scene = { cylALen , cylARad , cylAMat , coneBShape , coneBHeight , coneBMat , cylCLen , cylCRad , cylCMat , boxDShape , boxDMat , boxEShape , boxEMat , prismFShape , prismFMat , cylGLen , cylGRad , cylGMat , boxHShape , boxHMat } ; Camera camera = cameraLookAt ( eye , center , v3up ( ) , fovy , aspect , 0.0f , 1.0f ) ; vec3 col = v3zero ( ) ; for ( int x = 0 ; x < samplesAA ; x ++ ) { for ( int y = 0 ; y < samplesAA ; y ++ ) { float du = ( itof ( x ) / itof ( samplesAA ) - 0.5f ) / itof ( wh . x ) ; float dv = ( itof ( y ) / itof ( samplesAA ) - 0.5f ) / itof ( wh . y ) ; ray r = rayFromCamera ( camera , addv2 ( uv , v2 ( du , dv ) ) ) ; float d = rayMarch ( r . origin , r . direction , scene ) ; vec3 p = addv3 ( r . origin , mulv3f ( r . direction , d ) ) ; vec3 addition = ftov3 ( getLight ( p , eye , scene ) ) ; col = addv3 ( col , sqrtv3 ( addition ) ) ; } } col = divv3f ( col , itof ( samplesAA * samplesAA ) ) ; return v3tov4 ( col , 1.0f ) ; }\n"
-
-const val TYPES_DEF = DEF_RAY+DEF_AABB+DEF_CAMERA+DEF_LIGHT+DEF_PHONGMATERIAL+DEF_BVHNODE+DEF_SPHERE+DEF_LAMBERTIANMATERIAL+DEF_METALLICMATERIAL+DEF_DIELECTRICMATERIAL+DEF_HITRECORD+DEF_SCATTERRESULT+DEF_REFRACTRESULT+DEF_RAYMARCHERSCENE
-
-const val OPS_DEF = DEF_ADDF+DEF_SUBF+DEF_MULF+DEF_DIVF+DEF_EQV2+DEF_EQIV2+DEF_EQV3+DEF_EQV4+DEF_SCHLICKF+DEF_REMAPF+DEF_FTOV2+DEF_V2ZERO+DEF_ADDV2+DEF_DIVV2+DEF_DIVV2F+DEF_GETXV2+DEF_GETYV2+DEF_LENV2+DEF_INDEXV3+DEF_V2TOV3+DEF_FTOV3+DEF_V3ZERO+DEF_V3ONE+DEF_V3FRONT+DEF_V3BACK+DEF_V3LEFT+DEF_V3RIGHT+DEF_V3UP+DEF_V3DOWN+DEF_V3WHITE+DEF_V3BLACK+DEF_V3LTGREY+DEF_V3GREY+DEF_V3DKGREY+DEF_V3RED+DEF_V3GREEN+DEF_V3BLUE+DEF_V3YELLOW+DEF_V3MAGENTA+DEF_V3CYAN+DEF_V3ORANGE+DEF_V3ROSE+DEF_V3VIOLET+DEF_V3AZURE+DEF_V3AQUAMARINE+DEF_V3CHARTREUSE+DEF_XYV3+DEF_XZV3+DEF_YZV3+DEF_ABSV3+DEF_NEGV3+DEF_SUBV3F+DEF_POWV3+DEF_MIXV3+DEF_MAXV3+DEF_MINV3+DEF_LENV3+DEF_SQRTV3+DEF_LENSQV3+DEF_NORMV3+DEF_LERPV3+DEF_REFLECTV3+DEF_REFRACTV3+DEF_V3TOV4+DEF_FTOV4+DEF_V4TOV3+DEF_V4ZERO+DEF_V4ONE+DEF_ADDV4+DEF_SUBV4+DEF_MULV4+DEF_MULV4F+DEF_DIVV4+DEF_DIVV4F+DEF_GETXV4+DEF_GETYV4+DEF_GETZV4+DEF_GETWV4+DEF_GETRV4+DEF_GETGV4+DEF_GETBV4+DEF_GETAV4+DEF_SETXV4+DEF_SETYV4+DEF_SETZV4+DEF_SETWV4+DEF_SETRV4+DEF_SETGV4+DEF_SETBV4+DEF_SETAV4+DEF_IV2ZERO+DEF_IV2TOV2+DEF_IV2TOV4+DEF_GETXIV2+DEF_GETYIV2+DEF_GETUIV2+DEF_GETVIV2+DEF_TILE+DEF_RAYBACK+DEF_RAYPOINT+DEF_SDXZPLANE+DEF_SDSPHERE+DEF_SDBOX+DEF_SDCAPPEDCYLINDER+DEF_SDSIMPLIFIEDCYL+DEF_SDCONE+DEF_SDTRIPRISM+DEF_OPUNION+DEF_OPSUBTRACTION+DEF_OPINTERSECTION+DEF_RANDOMINUNITSPHERE+DEF_RANDOMINUNITDISK+DEF_CENTERUV+DEF_CAMERALOOKAT+DEF_RAYFROMCAMERA+DEF_BACKGROUND+DEF_RAYHITAABB+DEF_RAYHITSPHERERECORD+DEF_RAYHITSPHERE+DEF_RAYHITOBJECT+DEF_RAYHITBVH+DEF_RAYHITWORLD+DEF_SCATTERLAMBERTIAN+DEF_SCATTERMETALLIC+DEF_SCATTERDIELECTRIC+DEF_SCATTERMATERIAL+DEF_SAMPLECOLOR+DEF_FRAGMENTCOLORRT+DEF_GAMMASQRT+DEF_LUMINOSITY+DEF_DIFFUSECONTRIB+DEF_HALFVECTOR+DEF_SPECULARCONTRIB+DEF_LIGHTCONTRIB+DEF_POINTLIGHTCONTRIB+DEF_DIRLIGHTCONTRIB+DEF_SHADINGFLAT+DEF_SHADINGPHONG+DEF_DISTRIBUTIONGGX+DEF_GEOMETRYSCHLICKGGX+DEF_GEOMETRYSMITH+DEF_FRESNELSCHLICK+DEF_SHADINGPBR+DEF_SANDCONVERT+DEF_NEARBYCELLCOORDS+DEF_TRYDEPOSITPARTICLE+DEF_SIMTYPESAND+DEF_SIMTYPEWATER+DEF_SANDPHYSICS+DEF_SANDSOLVER+DEF_SANDDRAW+DEF_SCENEDIST+DEF_RAYMARCH+DEF_GETNORMAL+DEF_GETLIGHT+DEF_RAYMARCHER
-
-const val CONST_DEF = DEF_PI+DEF_BOUNCE_ERR+DEF_NO_HIT+DEF_NO_SCATTER+DEF_NO_REFRACT+DEF_TYPE_EMPTY+DEF_TYPE_SAND+DEF_TYPE_WATER+DEF_MAX_STEPS+DEF_MAX_DIST+DEF_SURF_DIST
+private const val DEF_MIN_DIST = "float MIN_DIST = 0.01f ;\n"
+private const val DEF_CULL_DIST = "float CULL_DIST = 0.5f ;\n"
+private const val DEF_MARCH_RELAXATION = "float MARCH_RELAXATION = 1.6f ;\n"
+private const val DEF_SHADOW_SOFTNESS = "float SHADOW_SOFTNESS = 8.0f ;\n"
+private const val DEF_SDFPRIMLIPSCHITZ = "float sdfPrimLipschitz ( SdfPrim prim ) { vec3 c0 = v4tov3 ( transformv4 ( v4 ( 1.0f , 0.0f , 0.0f , 0.0f ) , prim . transform ) ) ; vec3 c1 = v4tov3 ( transformv4 ( v4 ( 0.0f , 1.0f , 0.0f , 0.0f ) , prim . transform ) ) ; vec3 c2 = v4tov3 ( transformv4 ( v4 ( 0.0f , 0.0f , 1.0f , 0.0f ) , prim . transform ) ) ; float r0 = dotv3 ( c0 , c0 ) + absf ( dotv3 ( c0 , c1 ) ) + absf ( dotv3 ( c0 , c2 ) ) ; float r1 = absf ( dotv3 ( c1 , c0 ) ) + dotv3 ( c1 , c1 ) + absf ( dotv3 ( c1 , c2 ) ) ; float r2 = absf ( dotv3 ( c2 , c0 ) ) + absf ( dotv3 ( c2 , c1 ) ) + dotv3 ( c2 , c2 ) ; float stretch = sqrtf ( maxf ( r0 , maxf ( r1 , r2 ) ) ) ; float slope = 1.0f + absf ( prim . displace . x * prim . displace . y ) * sqrtf ( 3.0f ) ; return slope * stretch ; }\n"
+private const val DEF_SDFPRIMCREATE = "SdfPrim sdfPrimCreate ( int type , vec4 params , mat4 transform ) { SdfPrim result = { type , params , transform , v4zero ( ) , v4zero ( ) , v2zero ( ) , 1.0f } ; result . lipschitz = sdfPrimLipschitz ( result ) ; return result ; }\n"
+private const val DEF_SDFPRIMPLACED = "SdfPrim sdfPrimPlaced ( int type , vec4 params , mat4 placement ) { return sdfPrimCreate ( type , params , inversem4Affine ( placement ) ) ; }\n"
+private const val DEF_SDFPRIMREPEAT = "SdfPrim sdfPrimRepeat ( SdfPrim prim , vec3 period , vec3 limit ) { SdfPrim result = prim ; result . repeat = v3tov4 ( period , 0.0f ) ; result . limit = v3tov4 ( limit , 0.0f ) ; result . lipschitz = sdfPrimLipschitz ( result ) ; return result ; }\n"
+private const val DEF_SDFPRIMDISPLACE = "SdfPrim sdfPrimDisplace ( SdfPrim prim , float amplitude , float frequency ) { SdfPrim result = prim ; result . displace = v2 ( amplitude , frequency ) ; result . lipschitz = sdfPrimLipschitz ( result ) ; return result ; }\n"
+private const val DEF_SDFOPCREATE = "SdfOp sdfOpCreate ( int op , int index ) { SdfOp result = { op , index , 0.0f , v4zero ( ) , 1 , - 1 , - 1 } ; return result ; }\n"
+private const val DEF_SDFOPSMOOTH = "SdfOp sdfOpSmooth ( int op , float blend ) { SdfOp result = { op , 0 , blend , v4zero ( ) , 1 , - 1 , - 1 } ; return result ; }\n"
+private const val DEF_SDFPRIMLOCAL = "vec3 sdfPrimLocal ( vec3 p , SdfPrim prim ) { vec3 local = affinev3 ( p , prim . transform ) ; return opRepLim ( local , v4tov3 ( prim . repeat ) , v4tov3 ( prim . limit ) ) ; }\n"
+private const val DEF_SDFPRIMSHAPE = "float sdfPrimShape ( vec3 local , SdfPrim prim ) { switch ( prim . type ) { case SDF_SPHERE : return sdSphere ( local , prim . params . x ) ; case SDF_BOX : return sdBox ( local , v4tov3 ( prim . params ) ) ; case SDF_CYLINDER : return sdSimplifiedCyl ( local , prim . params . x , prim . params . y ) ; case SDF_CONE : return sdCone ( local , v2 ( prim . params . x , prim . params . y ) , prim . params . z ) ; case SDF_PRISM : return sdTriPrism ( local , v2 ( prim . params . x , prim . params . y ) ) ; case SDF_PLANE : return sdXZPlane ( local ) ; case SDF_TORUS : return sdTorus ( local , v2 ( prim . params . x , prim . params . y ) ) ; case SDF_CAPSULE : return sdCapsule ( local , v3 ( 0.0f , - prim . params . x * 0.5f , 0.0f ) , v3 ( 0.0f , prim . params . x * 0.5f , 0.0f ) , prim . params . y ) ; case SDF_ROUND_BOX : return sdRoundBox ( local , v4tov3 ( prim . params ) , prim . params . w ) ; case SDF_ELLIPSOID : return sdEllipsoid ( local , v4tov3 ( prim . params ) ) ; default : return error ( ) ; } }\n"
+private const val DEF_SDFPRIMDIST = "float sdfPrimDist ( vec3 p , SdfPrim prim ) { vec3 local = sdfPrimLocal ( p , prim ) ; float dist = sdfPrimShape ( local , prim ) ; if ( prim . displace . x != 0.0f ) { dist = opDisplace ( local , dist , prim . displace ) ; } return dist / prim . lipschitz ; }\n"
+private const val DEF_SDFPRIMGRAD = "vec4 sdfPrimGrad ( vec3 p , SdfPrim prim ) { vec3 local = sdfPrimLocal ( p , prim ) ; vec3 grad ; float dist ; if ( prim . type == SDF_SPHERE ) { float len = lenv3 ( local ) ; grad = len > 0.0f ? divv3f ( local , len ) : v3up ( ) ; dist = len - prim . params . x ; } else if ( prim . type == SDF_BOX ) { vec3 w = subv3 ( absv3 ( local ) , v4tov3 ( prim . params ) ) ; vec3 q = maxv3 ( w , v3zero ( ) ) ; float inside = maxf ( w . x , maxf ( w . y , w . z ) ) ; float len = lenv3 ( q ) ; if ( inside > 0.0f ) { grad = divv3f ( q , len ) ; } else if ( w . x > w . y && w . x > w . z ) { grad = v3 ( 1.0f , 0.0f , 0.0f ) ; } else if ( w . y > w . z ) { grad = v3 ( 0.0f , 1.0f , 0.0f ) ; } else { grad = v3 ( 0.0f , 0.0f , 1.0f ) ; } grad = mulv3 ( grad , v3 ( signf ( local . x ) , signf ( local . y ) , signf ( local . z ) ) ) ; dist = len + minf ( inside , 0.0f ) ; } else if ( prim . type == SDF_PLANE ) { grad = v3up ( ) ; dist = local . y ; } else { vec3 k0 = v3 ( 1.0f , - 1.0f , - 1.0f ) ; vec3 k1 = v3 ( - 1.0f , - 1.0f , 1.0f ) ; vec3 k2 = v3 ( - 1.0f , 1.0f , - 1.0f ) ; vec3 k3 = v3 ( 1.0f , 1.0f , 1.0f ) ; float d0 = sdfPrimDist ( addv3 ( p , mulv3f ( k0 , MIN_DIST ) ) , prim ) ; float d1 = sdfPrimDist ( addv3 ( p , mulv3f ( k1 , MIN_DIST ) ) , prim ) ; float d2 = sdfPrimDist ( addv3 ( p , mulv3f ( k2 , MIN_DIST ) ) , prim ) ; float d3 = sdfPrimDist ( addv3 ( p , mulv3f ( k3 , MIN_DIST ) ) , prim ) ; vec3 n = addv3 ( addv3 ( mulv3f ( k0 , d0 ) , mulv3f ( k1 , d1 ) ) , addv3 ( mulv3f ( k2 , d2 ) , mulv3f ( k3 , d3 ) ) ) ; return v3tov4 ( normv3 ( n ) , sdfPrimDist ( p , prim ) ) ; } if ( prim . displace . x != 0.0f ) { vec3 f = mulv3f ( local , prim . displace . y ) ; vec3 sines = v3 ( sinf ( f . x ) , sinf ( f . y ) , sinf ( f . z ) ) ; vec3 cosines = v3 ( cosf ( f . x ) , cosf ( f . y ) , cosf ( f . z ) ) ; vec3 slope = v3 ( cosines . x * sines . y * sines . z , sines . x * cosines . y * sines . z , sines . x * sines . y * cosines . z ) ; grad = addv3 ( grad , mulv3f ( slope , prim . displace . x * prim . displace . y ) ) ; dist = opDisplace ( local , dist , prim . displace ) ; } vec3 axisX = v4tov3 ( transformv4 ( v4 ( 1.0f , 0.0f , 0.0f , 0.0f ) , prim . transform ) ) ; vec3 axisY = v4tov3 ( transformv4 ( v4 ( 0.0f , 1.0f , 0.0f , 0.0f ) , prim . transform ) ) ; vec3 axisZ = v4tov3 ( transformv4 ( v4 ( 0.0f , 0.0f , 1.0f , 0.0f ) , prim . transform ) ) ; vec3 world = v3 ( dotv3 ( axisX , grad ) , dotv3 ( axisY , grad ) , dotv3 ( axisZ , grad ) ) ; return v3tov4 ( divv3f ( world , prim . lipschitz ) , dist / prim . lipschitz ) ; }\n"
+private const val DEF_SDFPRIMEXTENT = "vec3 sdfPrimExtent ( SdfPrim prim ) { vec3 extent ; switch ( prim . type ) { case SDF_SPHERE : extent = ftov3 ( prim . params . x ) ; break ; case SDF_BOX : case SDF_ROUND_BOX : case SDF_ELLIPSOID : extent = v4tov3 ( prim . params ) ; break ; case SDF_CYLINDER : extent = v3 ( prim . params . y , prim . params . y , prim . params . x * 0.5f ) ; break ; case SDF_CONE : extent = v3 ( prim . params . z * prim . params . x / prim . params . y , prim . params . z , prim . params . z * prim . params . x / prim . params . y ) ; break ; case SDF_PRISM : extent = v3 ( prim . params . x * 0.866025f , prim . params . x , prim . params . y ) ; break ; case SDF_TORUS : extent = v3 ( prim . params . x + prim . params . y , prim . params . y , prim . params . x + prim . params . y ) ; break ; case SDF_CAPSULE : extent = v3 ( prim . params . y , prim . params . x * 0.5f + prim . params . y , prim . params . y ) ; break ; default : return ftov3 ( FLT_MAX ) ; } vec3 period = absv3 ( v4tov3 ( prim . repeat ) ) ; if ( ( period . x > 0.0f && prim . limit . x <= 0.0f ) || ( period . y > 0.0f && prim . limit . y <= 0.0f ) || ( period . z > 0.0f && prim . limit . z <= 0.0f ) ) { return ftov3 ( FLT_MAX ) ; } vec3 copies = mulv3 ( period , v4tov3 ( prim . limit ) ) ; return addv3 ( addv3 ( extent , ftov3 ( absf ( prim . displace . x ) ) ) , copies ) ; }\n"
+private const val DEF_SDFPRIMBOX = "aabb sdfPrimBox ( SdfPrim prim ) { vec3 extent = sdfPrimExtent ( prim ) ; if ( maxf ( extent . x , maxf ( extent . y , extent . z ) ) == FLT_MAX ) { aabb endless = { ftov3 ( - FLT_MAX ) , ftov3 ( FLT_MAX ) } ; return endless ; } mat4 inverse = inversem4Affine ( prim . transform ) ; vec3 center = affinev3 ( v3zero ( ) , inverse ) ; vec3 axisX = absv3 ( v4tov3 ( transformv4 ( v4 ( 1.0f , 0.0f , 0.0f , 0.0f ) , inverse ) ) ) ; vec3 axisY = absv3 ( v4tov3 ( transformv4 ( v4 ( 0.0f , 1.0f , 0.0f , 0.0f ) , inverse ) ) ) ; vec3 axisZ = absv3 ( v4tov3 ( transformv4 ( v4 ( 0.0f , 0.0f , 1.0f , 0.0f ) , inverse ) ) ) ; vec3 halfExtent = addv3 ( addv3 ( mulv3f ( axisX , extent . x ) , mulv3f ( axisY , extent . y ) ) , mulv3f ( axisZ , extent . z ) ) ; aabb result = { subv3 ( center , halfExtent ) , addv3 ( center , halfExtent ) } ; return result ; }\n"
+private const val DEF_SDFPRIMBOUNDS = "vec4 sdfPrimBounds ( SdfPrim prim ) { vec3 extent = sdfPrimExtent ( prim ) ; if ( maxf ( extent . x , maxf ( extent . y , extent . z ) ) == FLT_MAX ) { return v4 ( 0.0f , 0.0f , 0.0f , FLT_MAX ) ; } float radius ; switch ( prim . type ) { case SDF_SPHERE : radius = prim . params . x ; break ; case SDF_CYLINDER : radius = lenv2 ( v2 ( prim . params . x * 0.5f , prim . params . y ) ) ; break ; case SDF_CONE : radius = lenv2 ( v2 ( prim . params . z * prim . params . x / prim . params . y , prim . params . z ) ) ; break ; case SDF_PRISM : radius = lenv2 ( v2 ( prim . params . x , prim . params . y ) ) ; break ; case SDF_TORUS : radius = prim . params . x + prim . params . y ; break ; case SDF_CAPSULE : radius = prim . params . x * 0.5f + prim . params . y ; break ; case SDF_ELLIPSOID : radius = maxf ( prim . params . x , maxf ( prim . params . y , prim . params . z ) ) ; break ; default : radius = lenv3 ( v4tov3 ( prim . params ) ) ; break ; } radius += absf ( prim . displace . x ) + lenv3 ( mulv3 ( absv3 ( v4tov3 ( prim . repeat ) ) , v4tov3 ( prim . limit ) ) ) ; mat4 inverse = inversem4Affine ( prim . transform ) ; float scale = maxf ( lenv3 ( v4tov3 ( transformv4 ( v4 ( 1.0f , 0.0f , 0.0f , 0.0f ) , inverse ) ) ) , maxf ( lenv3 ( v4tov3 ( transformv4 ( v4 ( 0.0f , 1.0f , 0.0f , 0.0f ) , inverse ) ) ) , lenv3 ( v4tov3 ( transformv4 ( v4 ( 0.0f , 0.0f , 1.0f , 0.0f ) , inverse ) ) ) ) ) ; return v3tov4 ( affinev3 ( v3zero ( ) , inverse ) , radius * scale ) ; }\n"
+private const val DEF_SDFBOUNDSUNION = "vec4 sdfBoundsUnion ( vec4 left , vec4 right ) { vec3 between = subv3 ( v4tov3 ( right ) , v4tov3 ( left ) ) ; float dist = lenv3 ( between ) ; if ( dist + right . w <= left . w ) { return left ; } if ( dist + left . w <= right . w ) { return right ; } float radius = ( dist + left . w + right . w ) * 0.5f ; return v3tov4 ( addv3 ( v4tov3 ( left ) , mulv3f ( between , ( radius - left . w ) / dist ) ) , radius ) ; }\n"
+private const val DEF_SCENEDIST = "float sceneDist ( vec3 p ) { float stack [ SDF_STACK ] ; int top = 0 ; int i = 0 ; while ( i < uSdfOpsCnt ) { SdfOp op = uSdfOps [ i ] ; i ++ ; if ( op . op == SDF_OP_PRIM ) { int end = op . outer ; while ( end >= 0 ) { vec4 bounds = uSdfOps [ end ] . bounds ; float centerDist = lenv3 ( subv3 ( p , v4tov3 ( bounds ) ) ) ; if ( centerDist - bounds . w > CULL_DIST ) { break ; } end = uSdfOps [ end ] . inner ; } if ( end >= 0 ) { vec4 bounds = uSdfOps [ end ] . bounds ; float centerDist = lenv3 ( subv3 ( p , v4tov3 ( bounds ) ) ) ; stack [ top ] = uSdfOps [ end ] . polarity > 0 ? centerDist - bounds . w : centerDist + bounds . w ; i = end + 1 ; } else { stack [ top ] = sdfPrimDist ( p , uSdfPrims [ op . index ] ) ; } top ++ ; } else { top -- ; float left = stack [ top - 1 ] ; float right = stack [ top ] ; if ( op . op == SDF_OP_UNION ) { stack [ top - 1 ] = opUnion ( left , right ) ; } else if ( op . op == SDF_OP_SUBTRACTION ) { stack [ top - 1 ] = opSubtraction ( left , right ) ; } else if ( op . op == SDF_OP_INTERSECTION ) { stack [ top - 1 ] = opIntersection ( left , right ) ; } else if ( op . op == SDF_OP_SMOOTH_UNION ) { stack [ top - 1 ] = opSmoothUnion ( left , right , op . blend ) ; } else if ( op . op == SDF_OP_SMOOTH_SUBTRACTION ) { stack [ top - 1 ] = opSmoothSubtraction ( left , right , op . blend ) ; } else { stack [ top - 1 ] = opSmoothIntersection ( left , right , op . blend ) ; } } } return stack [ 0 ] ; }\n"
+private const val DEF_SDFGRADNEG = "vec4 sdfGradNeg ( vec4 grad ) { return v3tov4 ( negv3 ( v4tov3 ( grad ) ) , - grad . w ) ; }\n"
+private const val DEF_SDFSMOOTHGRAD = "vec4 sdfSmoothGrad ( vec4 left , vec4 right , float k ) { float h = maxf ( k - absf ( left . w - right . w ) , 0.0f ) / k ; vec4 closer = left . w < right . w ? left : right ; vec4 farther = left . w < right . w ? right : left ; return v3tov4 ( mixv3 ( v4tov3 ( closer ) , v4tov3 ( farther ) , h * 0.5f ) , opSmoothUnion ( left . w , right . w , k ) ) ; }\n"
+private const val DEF_SCENEDISTGRAD = "vec4 sceneDistGrad ( vec3 p ) { vec4 stack [ SDF_STACK ] ; int top = 0 ; int i = 0 ; while ( i < uSdfOpsCnt ) { SdfOp op = uSdfOps [ i ] ; i ++ ; if ( op . op == SDF_OP_PRIM ) { int end = op . outer ; while ( end >= 0 ) { vec4 bounds = uSdfOps [ end ] . bounds ; float centerDist = lenv3 ( subv3 ( p , v4tov3 ( bounds ) ) ) ; if ( centerDist - bounds . w > CULL_DIST ) { break ; } end = uSdfOps [ end ] . inner ; } if ( end >= 0 ) { vec4 bounds = uSdfOps [ end ] . bounds ; vec3 away = subv3 ( p , v4tov3 ( bounds ) ) ; float centerDist = lenv3 ( away ) ; float dist = uSdfOps [ end ] . polarity > 0 ? centerDist - bounds . w : centerDist + bounds . w ; stack [ top ] = v3tov4 ( divv3f ( away , centerDist ) , dist ) ; i = end + 1 ; } else { stack [ top ] = sdfPrimGrad ( p , uSdfPrims [ op . index ] ) ; } top ++ ; } else { top -- ; vec4 left = stack [ top - 1 ] ; vec4 right = stack [ top ] ; if ( op . op == SDF_OP_UNION ) { stack [ top - 1 ] = left . w < right . w ? left : right ; } else if ( op . op == SDF_OP_SUBTRACTION ) { stack [ top - 1 ] = - left . w > right . w ? sdfGradNeg ( left ) : right ; } else if ( op . op == SDF_OP_INTERSECTION ) { stack [ top - 1 ] = left . w > right . w ? left : right ; } else if ( op . op == SDF_OP_SMOOTH_UNION ) { stack [ top - 1 ] = sdfSmoothGrad ( left , right , op . blend ) ; } else if ( op . op == SDF_OP_SMOOTH_SUBTRACTION ) { stack [ top - 1 ] = sdfGradNeg ( sdfSmoothGrad ( left , sdfGradNeg ( right ) , op . blend ) ) ; } else { stack [ top - 1 ] = sdfGradNeg ( sdfSmoothGrad ( sdfGradNeg ( left ) , sdfGradNeg ( right ) , op . blend ) ) ; } } } return stack [ 0 ] ; }\n"
+private const val DEF_RAYMARCH = "float rayMarch ( vec3 ro , vec3 rd ) { float dO = 0.0f ; for ( int i = 0 ; i < MAX_STEPS ; i ++ ) { vec3 p = addv3 ( ro , mulv3f ( rd , dO ) ) ; float dS = sceneDist ( p ) ; dO += dS ; if ( dO > MAX_DIST || dS < MIN_DIST ) break ; } return dO ; }\n"
+private const val DEF_MARCHEPSILON = "float marchEpsilon ( float t , float pixelRadius ) { return maxf ( MIN_DIST , pixelRadius * t ) ; }\n"
+private const val DEF_RAYMARCHMODE = "MarchResult rayMarchMode ( vec3 ro , vec3 rd , int mode , float pixelRadius ) { float omega = mode == MARCH_RELAXED ? MARCH_RELAXATION : 1.0f ; float t = 0.0f ; float stepLen = 0.0f ; float prevRadius = 0.0f ; float candidateT = 0.0f ; float candidateErr = FLT_MAX ; bool finished = false ; int steps = 0 ; for ( int i = 0 ; i < MAX_STEPS ; i ++ ) { steps ++ ; float dS = sceneDist ( addv3 ( ro , mulv3f ( rd , t ) ) ) ; float radius = absf ( dS ) ; bool sorFail = omega > 1.0f && radius + prevRadius < stepLen ; if ( sorFail ) { stepLen -= omega * stepLen ; omega = 1.0f ; } else { stepLen = dS * omega ; float epsilon = marchEpsilon ( t , pixelRadius ) ; float err = radius / epsilon ; if ( err < candidateErr ) { candidateT = t ; candidateErr = err ; } if ( dS < epsilon ) { finished = true ; break ; } } prevRadius = radius ; t += stepLen ; if ( t > MAX_DIST ) { finished = true ; break ; } } MarchResult result = { finished ? t : candidateT , steps } ; return result ; }\n"
+private const val DEF_GETNORMAL = "vec3 getNormal ( vec3 p ) { vec3 k0 = v3 ( 1.0f , - 1.0f , - 1.0f ) ; vec3 k1 = v3 ( - 1.0f , - 1.0f , 1.0f ) ; vec3 k2 = v3 ( - 1.0f , 1.0f , - 1.0f ) ; vec3 k3 = v3 ( 1.0f , 1.0f , 1.0f ) ; vec3 n = addv3 ( addv3 ( mulv3f ( k0 , sceneDist ( addv3 ( p , mulv3f ( k0 , MIN_DIST ) ) ) ) , mulv3f ( k1 , sceneDist ( addv3 ( p , mulv3f ( k1 , MIN_DIST ) ) ) ) ) , addv3 ( mulv3f ( k2 , sceneDist ( addv3 ( p , mulv3f ( k2 , MIN_DIST ) ) ) ) , mulv3f ( k3 , sceneDist ( addv3 ( p , mulv3f ( k3 , MIN_DIST ) ) ) ) ) ) ; return normv3 ( n ) ; }\n"
+private const val DEF_GETNORMALANALYTIC = "vec3 getNormalAnalytic ( vec3 p ) { return normv3 ( v4tov3 ( sceneDistGrad ( p ) ) ) ; }\n"
+private const val DEF_SHADOWSOFT = "float shadowSoft ( vec3 ro , vec3 rd , float maxT ) { float res = 1.0f ; float t = MIN_DIST ; for ( int i = 0 ; i < MAX_STEPS ; i ++ ) { float h = sceneDist ( addv3 ( ro , mulv3f ( rd , t ) ) ) ; res = minf ( res , SHADOW_SOFTNESS * h / t ) ; if ( res < MIN_DIST ) { return 0.0f ; } t += clampf ( h , MIN_DIST , maxT ) ; if ( t > maxT ) { break ; } } return clampf ( res , 0.0f , 1.0f ) ; }\n"
+private const val DEF_GETLIGHTMODE = "float getLightMode ( vec3 p , vec3 eye , int shadow ) { vec3 l = normv3 ( subv3 ( eye , p ) ) ; vec3 n = getNormalAnalytic ( p ) ; vec3 ro = addv3 ( p , mulv3f ( n , MIN_DIST * 2.0f ) ) ; float lightDist = lenv3 ( subv3 ( eye , p ) ) ; float a = clampf ( dotv3 ( n , l ) , 0.0f , 1.0f ) ; if ( shadow == SHADOW_SOFT ) { a *= 0.1f + 0.9f * shadowSoft ( ro , l , lightDist ) ; } else { float d = rayMarch ( ro , l ) ; if ( d < lightDist ) a *= 0.1f ; } return a ; }\n"
+private const val DEF_GETLIGHT = "float getLight ( vec3 p , vec3 eye ) { return getLightMode ( p , eye , SHADOW_HARD ) ; }\n"
+private const val DEF_RAYMARCHERSDFMODE = "vec4 raymarcherSdfMode ( vec3 eye , vec3 center , vec2 uv , float fovy , float aspect , ivec2 wh , int samplesAA , int mode , int shadow ) { Camera camera = cameraLookAt ( eye , center , v3up ( ) , fovy , aspect , 0.0f , 1.0f ) ; float pixelRadius = tanf ( fovy / 2.0f ) / itof ( wh . y ) ; vec3 col = v3zero ( ) ; for ( int x = 0 ; x < samplesAA ; x ++ ) { for ( int y = 0 ; y < samplesAA ; y ++ ) { float du = ( itof ( x ) / itof ( samplesAA ) - 0.5f ) / itof ( wh . x ) ; float dv = ( itof ( y ) / itof ( samplesAA ) - 0.5f ) / itof ( wh . y ) ; ray r = rayFromCamera ( camera , addv2 ( uv , v2 ( du , dv ) ) ) ; float d = rayMarchMode ( r . origin , r . direction , mode , pixelRadius ) . t ; vec3 p = addv3 ( r . origin , mulv3f ( r . direction , d ) ) ; vec3 addition = ftov3 ( getLightMode ( p , eye , shadow ) ) ; col = addv3 ( col , sqrtv3 ( addition ) ) ; } } col = divv3f ( col , itof ( samplesAA * samplesAA ) ) ; return v3tov4 ( col , 1.0f ) ; }\n"
+private const val DEF_RAYMARCHERSDF = "vec4 raymarcherSdf ( vec3 eye , vec3 center , vec2 uv , float fovy , float aspect , ivec2 wh , int samplesAA ) { return raymarcherSdfMode ( eye , center , uv , fovy , aspect , wh , samplesAA , MARCH_PLAIN , SHADOW_HARD ) ; }\n"
+
+const val TYPES_DEF = DEF_RAY+DEF_AABB+DEF_CAMERA+DEF_LIGHT+DEF_PHONGMATERIAL+DEF_BVHNODE+DEF_SPHERE+DEF_LAMBERTIANMATERIAL+DEF_METALLICMATERIAL+DEF_DIELECTRICMATERIAL+DEF_HITRECORD+DEF_SCATTERRESULT+DEF_REFRACTRESULT+DEF_MARCHRESULT+DEF_SDFPRIM+DEF_SDFOP
+
+const val OPS_DEF = DEF_ADDF+DEF_SUBF+DEF_MULF+DEF_DIVF+DEF_EQV2+DEF_EQIV2+DEF_EQV3+DEF_EQV4+DEF_SCHLICKF+DEF_REMAPF+DEF_FTOV2+DEF_V2ZERO+DEF_ADDV2+DEF_DIVV2+DEF_DIVV2F+DEF_GETXV2+DEF_GETYV2+DEF_LENV2+DEF_INDEXV3+DEF_V2TOV3+DEF_FTOV3+DEF_V3ZERO+DEF_V3ONE+DEF_V3FRONT+DEF_V3BACK+DEF_V3LEFT+DEF_V3RIGHT+DEF_V3UP+DEF_V3DOWN+DEF_V3WHITE+DEF_V3BLACK+DEF_V3LTGREY+DEF_V3GREY+DEF_V3DKGREY+DEF_V3RED+DEF_V3GREEN+DEF_V3BLUE+DEF_V3YELLOW+DEF_V3MAGENTA+DEF_V3CYAN+DEF_V3ORANGE+DEF_V3ROSE+DEF_V3VIOLET+DEF_V3AZURE+DEF_V3AQUAMARINE+DEF_V3CHARTREUSE+DEF_XYV3+DEF_XZV3+DEF_YZV3+DEF_ABSV3+DEF_NEGV3+DEF_SUBV3F+DEF_POWV3+DEF_MIXV3+DEF_MAXV3+DEF_MINV3+DEF_LENV3+DEF_SQRTV3+DEF_LENSQV3+DEF_NORMV3+DEF_LERPV3+DEF_REFLECTV3+DEF_REFRACTV3+DEF_V3TOV4+DEF_FTOV4+DEF_V4TOV3+DEF_V4ZERO+DEF_V4ONE+DEF_ADDV4+DEF_SUBV4+DEF_MULV4+DEF_MULV4F+DEF_DIVV4+DEF_DIVV4F+DEF_GETXV4+DEF_GETYV4+DEF_GETZV4+DEF_GETWV4+DEF_GETRV4+DEF_GETGV4+DEF_GETBV4+DEF_GETAV4+DEF_SETXV4+DEF_SETYV4+DEF_SETZV4+DEF_SETWV4+DEF_SETRV4+DEF_SETGV4+DEF_SETBV4+DEF_SETAV4+DEF_IV2ZERO+DEF_IV2TOV2+DEF_IV2TOV4+DEF_GETXIV2+DEF_GETYIV2+DEF_GETUIV2+DEF_GETVIV2+DEF_TILE+DEF_RAYBACK+DEF_RAYPOINT+DEF_SDXZPLANE+DEF_SDSPHERE+DEF_SDBOX+DEF_SDCAPPEDCYLINDER+DEF_SDSIMPLIFIEDCYL+DEF_SDCONE+DEF_SDTRIPRISM+DEF_SDTORUS+DEF_SDCAPSULE+DEF_SDROUNDBOX+DEF_SDELLIPSOID+DEF_OPUNION+DEF_OPSUBTRACTION+DEF_OPINTERSECTION+DEF_OPSMOOTHUNION+DEF_OPSMOOTHSUBTRACTION+DEF_OPSMOOTHINTERSECTION+DEF_OPREPAXIS+DEF_OPREP+DEF_OPREPLIM+DEF_OPDISPLACE+DEF_RANDOMINUNITSPHERE+DEF_RANDOMINUNITDISK+DEF_CENTERUV+DEF_CAMERALOOKAT+DEF_RAYFROMCAMERA+DEF_BACKGROUND+DEF_RAYHITAABB+DEF_RAYHITSPHERERECORD+DEF_RAYHITSPHERE+DEF_RAYHITOBJECT+DEF_RAYHITBVH+DEF_SCATTERLAMBERTIAN+DEF_SCATTERMETALLIC+DEF_SCATTERDIELECTRIC+DEF_SCATTERMATERIAL+DEF_SAMPLECOLOR+DEF_FRAGMENTCOLORRT+DEF_GAMMASQRT+DEF_LUMINOSITY+DEF_DIFFUSECONTRIB+DEF_HALFVECTOR+DEF_SPECULARCONTRIB+DEF_LIGHTCONTRIB+DEF_POINTLIGHTCONTRIB+DEF_DIRLIGHTCONTRIB+DEF_SHADINGFLAT+DEF_SHADINGPHONG+DEF_DISTRIBUTIONGGX+DEF_GEOMETRYSCHLICKGGX+DEF_GEOMETRYSMITH+DEF_FRESNELSCHLICK+DEF_SHADINGPBR+DEF_SANDPACK+DEF_SANDTYPE+DEF_SANDMOVE+DEF_SANDSEED+DEF_SANDCELLAT+DEF_SANDCONVERT+DEF_SANDRND+DEF_NEARBYCELLCOORDS+DEF_TRYDEPOSITPARTICLE+DEF_SIMTYPESAND+DEF_SIMTYPEWATER+DEF_SANDPHYSICS+DEF_SANDSOLVER+DEF_SANDBLOCKCELL+DEF_SANDBLOCKMOVABLE+DEF_SANDMARGOLUS+DEF_SANDDRAW+DEF_SDFPRIMLIPSCHITZ+DEF_SDFPRIMCREATE+DEF_SDFPRIMPLACED+DEF_SDFPRIMREPEAT+DEF_SDFPRIMDISPLACE+DEF_SDFOPCREATE+DEF_SDFOPSMOOTH+DEF_SDFPRIMLOCAL+DEF_SDFPRIMSHAPE+DEF_SDFPRIMDIST+DEF_SDFPRIMGRAD+DEF_SDFPRIMEXTENT+DEF_SDFPRIMBOX+DEF_SDFPRIMBOUNDS+DEF_SDFBOUNDSUNION+DEF_SCENEDIST+DEF_SDFGRADNEG+DEF_SDFSMOOTHGRAD+DEF_SCENEDISTGRAD+DEF_RAYMARCH+DEF_MARCHEPSILON+DEF_RAYMARCHMODE+DEF_GETNORMAL+DEF_GETNORMALANALYTIC+DEF_SHADOWSOFT+DEF_GETLIGHTMODE+DEF_GETLIGHT+DEF_RAYMARCHERSDFMODE+DEF_RAYMARCHERSDF
+
+const val CONST_DEF = DEF_PI+DEF_BOUNCE_ERR+DEF_NO_HIT+DEF_NO_SCATTER+DEF_NO_REFRACT+DEF_TYPE_EMPTY+DEF_TYPE_SAND+DEF_TYPE_WATER+DEF_TYPE_WALL+DEF_MAX_STEPS+DEF_MAX_DIST+DEF_MIN_DIST+DEF_CULL_DIST+DEF_MARCH_RELAXATION+DEF_SHADOW_SOFTNESS
 
 fun error() = object : Expression<Float>() {
     override fun expr() = "error()"
@@ -876,6 +925,16 @@ fun transformv4(vec: Expression<vec4>, mat: Expression<mat4>) = object : Express
     override fun roots() = listOf(vec, mat)
 }
 
+fun affinev3(vec: Expression<vec3>, mat: Expression<mat4>) = object : Expression<vec3>() {
+    override fun expr() = "affinev3(${vec.expr()}, ${mat.expr()})"
+    override fun roots() = listOf(vec, mat)
+}
+
+fun inversem4Affine(mat: Expression<mat4>) = object : Expression<mat4>() {
+    override fun expr() = "inversem4Affine(${mat.expr()})"
+    override fun roots() = listOf(mat)
+}
+
 fun translatem4(vec: Expression<vec3>) = object : Expression<mat4>() {
     override fun expr() = "translatem4(${vec.expr()})"
     override fun roots() = listOf(vec)
@@ -936,6 +995,26 @@ fun sdTriPrism(p: Expression<vec3>, h: Expression<vec2>) = object : Expression<F
     override fun roots() = listOf(p, h)
 }
 
+fun sdTorus(p: Expression<vec3>, t: Expression<vec2>) = object : Expression<Float>() {
+    override fun expr() = "sdTorus(${p.expr()}, ${t.expr()})"
+    override fun roots() = listOf(p, t)
+}
+
+fun sdCapsule(p: Expression<vec3>, a: Expression<vec3>, b: Expression<vec3>, r: Expression<Float>) = object : Expression<Float>() {
+    override fun expr() = "sdCapsule(${p.expr()}, ${a.expr()}, ${b.expr()}, ${r.expr()})"
+    override fun roots() = listOf(p, a, b, r)
+}
+
+fun sdRoundBox(p: Expression<vec3>, b: Expression<vec3>, r: Expression<Float>) = object : Expression<Float>() {
+    override fun expr() = "sdRoundBox(${p.expr()}, ${b.expr()}, ${r.expr()})"
+    override fun roots() = listOf(p, b, r)
+}
+
+fun sdEllipsoid(p: Expression<vec3>, r: Expression<vec3>) = object : Expression<Float>() {
+    override fun expr() = "sdEllipsoid(${p.expr()}, ${r.expr()})"
+    override fun roots() = listOf(p, r)
+}
+
 fun opUnion(d1: Expression<Float>, d2: Expression<Float>) = object : Expression<Float>() {
     override fun expr() = "opUnion(${d1.expr()}, ${d2.expr()})"
     override fun roots() = listOf(d1, d2)
@@ -951,6 +1030,41 @@ fun opIntersection(d1: Expression<Float>, d2: Expression<Float>) = object : Expr
     override fun roots() = listOf(d1, d2)
 }
 
+fun opSmoothUnion(d1: Expression<Float>, d2: Expression<Float>, k: Expression<Float>) = object : Expression<Float>() {
+    override fun expr() = "opSmoothUnion(${d1.expr()}, ${d2.expr()}, ${k.expr()})"
+    override fun roots() = listOf(d1, d2, k)
+}
+
+fun opSmoothSubtraction(d1: Expression<Float>, d2: Expression<Float>, k: Expression<Float>) = object : Expression<Float>() {
+    override fun expr() = "opSmoothSubtraction(${d1.expr()}, ${d2.expr()}, ${k.expr()})"
+    override fun roots() = listOf(d1, d2, k)
+}
+
+fun opSmoothIntersection(d1: Expression<Float>, d2: Expression<Float>, k: Expression<Float>) = object : Expression<Float>() {
+    override fun expr() = "opSmoothIntersection(${d1.expr()}, ${d2.expr()}, ${k.expr()})"
+    override fun roots() = listOf(d1, d2, k)
+}
+
+fun opRepAxis(p: Expression<Float>, c: Expression<Float>, l: Expression<Float>) = object : Expression<Float>() {
+    override fun expr() = "opRepAxis(${p.expr()}, ${c.expr()}, ${l.expr()})"
+    override fun roots() = listOf(p, c, l)
+}
+
+fun opRep(p: Expression<vec3>, c: Expression<vec3>) = object : Expression<vec3>() {
+    override fun expr() = "opRep(${p.expr()}, ${c.expr()})"
+    override fun roots() = listOf(p, c)
+}
+
+fun opRepLim(p: Expression<vec3>, c: Expression<vec3>, l: Expression<vec3>) = object : Expression<vec3>() {
+    override fun expr() = "opRepLim(${p.expr()}, ${c.expr()}, ${l.expr()})"
+    override fun roots() = listOf(p, c, l)
+}
+
+fun opDisplace(p: Expression<vec3>, d: Expression<Float>, displace: Expression<vec2>) = object : Expression<Float>() {
+    override fun expr() = "opDisplace(${p.expr()}, ${d.expr()}, ${displace.expr()})"
+    override fun roots() = listOf(p, d, displace)
+}
+
 fun rndf(x: Expression<Float>) = object : Expression<Float>() {
     override fun expr() = "rndf(${x.expr()})"
     override fun roots() = listOf(x)
@@ -1091,14 +1205,44 @@ fun shadingPbr(eye: Expression<vec3>, worldPos: Expression<vec3>, albedo: Expres
     override fun roots() = listOf(eye, worldPos, albedo, N, metallic, roughness, ao)
 }
 
+fun sandPack(type: Expression<Int>, move: Expression<vec2i>, seed: Expression<Int>) = object : Expression<Int>() {
+    override fun expr() = "sandPack(${type.expr()}, ${move.expr()}, ${seed.expr()})"
+    override fun roots() = listOf(type, move, seed)
+}
+
+fun sandType(cell: Expression<Int>) = object : Expression<Int>() {
+    override fun expr() = "sandType(${cell.expr()})"
+    override fun roots() = listOf(cell)
+}
+
+fun sandMove(cell: Expression<Int>) = object : Expression<vec2i>() {
+    override fun expr() = "sandMove(${cell.expr()})"
+    override fun roots() = listOf(cell)
+}
+
+fun sandSeed(cell: Expression<Int>) = object : Expression<Int>() {
+    override fun expr() = "sandSeed(${cell.expr()})"
+    override fun roots() = listOf(cell)
+}
+
+fun sandCellAt(orig: Expression<GlTexture>, uv: Expression<vec2>) = object : Expression<Int>() {
+    override fun expr() = "sandCellAt(${orig.expr()}, ${uv.expr()})"
+    override fun roots() = listOf(orig, uv)
+}
+
 fun sandConvert(pixel: Expression<vec4>) = object : Expression<vec4>() {
     override fun expr() = "sandConvert(${pixel.expr()})"
     override fun roots() = listOf(pixel)
 }
 
-fun sandPhysics(orig: Expression<GlTexture>, uv: Expression<vec2>, wh: Expression<vec2i>) = object : Expression<vec4>() {
-    override fun expr() = "sandPhysics(${orig.expr()}, ${uv.expr()}, ${wh.expr()})"
-    override fun roots() = listOf(orig, uv, wh)
+fun sandRnd(cell: Expression<vec2i>, frame: Expression<Int>, material: Expression<Int>) = object : Expression<Float>() {
+    override fun expr() = "sandRnd(${cell.expr()}, ${frame.expr()}, ${material.expr()})"
+    override fun roots() = listOf(cell, frame, material)
+}
+
+fun sandPhysics(orig: Expression<GlTexture>, uv: Expression<vec2>, wh: Expression<vec2i>, frame: Expression<Int>) = object : Expression<vec4>() {
+    override fun expr() = "sandPhysics(${orig.expr()}, ${uv.expr()}, ${wh.expr()}, ${frame.expr()})"
+    override fun roots() = listOf(orig, uv, wh, frame)
 }
 
 fun sandSolver(orig: Expression<GlTexture>, deltas: Expression<GlTexture>, uv: Expression<vec2>, wh: Expression<vec2i>) = object : Expression<vec4>() {
@@ -1106,13 +1250,23 @@ fun sandSolver(orig: Expression<GlTexture>, deltas: Expression<GlTexture>, uv: E
     override fun roots() = listOf(orig, deltas, uv, wh)
 }
 
+fun sandMargolus(orig: Expression<GlTexture>, uv: Expression<vec2>, wh: Expression<vec2i>, frame: Expression<Int>) = object : Expression<vec4>() {
+    override fun expr() = "sandMargolus(${orig.expr()}, ${uv.expr()}, ${wh.expr()}, ${frame.expr()})"
+    override fun roots() = listOf(orig, uv, wh, frame)
+}
+
 fun sandDraw(orig: Expression<GlTexture>, uv: Expression<vec2>, wh: Expression<vec2i>) = object : Expression<vec4>() {
     override fun expr() = "sandDraw(${orig.expr()}, ${uv.expr()}, ${wh.expr()})"
     override fun roots() = listOf(orig, uv, wh)
 }
 
-fun raymarcher(eye: Expression<vec3>, center: Expression<vec3>, uv: Expression<vec2>, fovy: Expression<Float>, aspect: Expression<Float>, wh: Expression<vec2i>, samplesAA: Expression<Int>, cylALen: Expression<Float>, cylARad: Expression<Float>, cylAMat: Expression<mat4>, coneBShape: Expression<vec2>, coneBHeight: Expression<Float>, coneBMat: Expression<mat4>, cylCLen: Expression<Float>, cylCRad: Expression<Float>, cylCMat: Expression<mat4>, boxDShape: Expression<vec3>, boxDMat: Expression<mat4>, boxEShape: Expression<vec3>, boxEMat: Expression<mat4>, prismFShape: Expression<vec2>, prismFMat: Expression<mat4>, cylGLen: Expression<Float>, cylGRad: Expression<Float>, cylGMat: Expression<mat4>, boxHShape: Expression<vec3>, boxHMat: Expression<mat4>) = object : Expression<vec4>() {
-    override fun expr() = "raymarcher(${eye.expr()}, ${center.expr()}, ${uv.expr()}, ${fovy.expr()}, ${aspect.expr()}, ${wh.expr()}, ${samplesAA.expr()}, ${cylALen.expr()}, ${cylARad.expr()}, ${cylAMat.expr()}, ${coneBShape.expr()}, ${coneBHeight.expr()}, ${coneBMat.expr()}, ${cylCLen.expr()}, ${cylCRad.expr()}, ${cylCMat.expr()}, ${boxDShape.expr()}, ${boxDMat.expr()}, ${boxEShape.expr()}, ${boxEMat.expr()}, ${prismFShape.expr()}, ${prismFMat.expr()}, ${cylGLen.expr()}, ${cylGRad.expr()}, ${cylGMat.expr()}, ${boxHShape.expr()}, ${boxHMat.expr()})"
-    override fun roots() = listOf(eye, center, uv, fovy, aspect, wh, samplesAA, cylALen, cylARad, cylAMat, coneBShape, coneBHeight, coneBMat, cylCLen, cylCRad, cylCMat, boxDShape, boxDMat, boxEShape, boxEMat, prismFShape, prismFMat, cylGLen, cylGRad, cylGMat, boxHShape, boxHMat)
+fun raymarcherSdfMode(eye: Expression<vec3>, center: Expression<vec3>, uv: Expression<vec2>, fovy: Expression<Float>, aspect: Expression<Float>, wh: Expression<vec2i>, samplesAA: Expression<Int>, mode: Expression<Int>, shadow: Expression<Int>) = object : Expression<vec4>() {
+    override fun expr() = "raymarcherSdfMode(${eye.expr()}, ${center.expr()}, ${uv.expr()}, ${fovy.expr()}, ${aspect.expr()}, ${wh.expr()}, ${samplesAA.expr()}, ${mode.expr()}, ${shadow.expr()})"
+    override fun roots() = listOf(eye, center, uv, fovy, aspect, wh, samplesAA, mode, shadow)
+}
+
+fun raymarcherSdf(eye: Expression<vec3>, center: Expression<vec3>, uv: Expression<vec2>, fovy: Expression<Float>, aspect: Expression<Float>, wh: Expression<vec2i>, samplesAA: Expression<Int>) = object : Expression<vec4>() {
+    override fun expr() = "raymarcherSdf(${eye.expr()}, ${center.expr()}, ${uv.expr()}, ${fovy.expr()}, ${aspect.expr()}, ${wh.expr()}, ${samplesAA.expr()})"
+    override fun roots() = listOf(eye, center, uv, fovy, aspect, wh, samplesAA)
 }
 
@@ -155,6 +155,27 @@ internal fun glProgramArrayUniform(program: GlProgram, name: String, index: Int,
     backend.glUniform3fv(location, bufferVec3)
 }
 
+internal fun glProgramArrayUniform(program: GlProgram, name: String, index: Int, value: vec2) {
+    glProgramCheckBound(program)
+    val location = glProgramUniformLocation(program, name.format(index))
+    value.get(bufferVec2)
+    backend.glUniform2fv(location, bufferVec2)
+}
+
+internal fun glProgramArrayUniform(program: GlProgram, name: String, index: Int, value: vec4) {
+    glProgramCheckBound(program)
+    val location = glProgramUniformLocation(program, name.format(index))
+    value.get(bufferVec4)
+    backend.glUniform4fv(location, bufferVec4)
+}
+
+internal fun glProgramArrayUniform(program: GlProgram, name: String, index: Int, value: mat4) {
+    glProgramCheckBound(program)
+    val location = glProgramUniformLocation(program, name.format(index))
+    value.get(bufferMat4)
+    backend.glUniformMatrix4fv(location, false, bufferMat4)
+}
+
 internal fun glProgramSubmitLights(program: GlProgram, lights: List<Light>) {
     check(lights.size <= MAX_LIGHTS) { "More lights than defined in shader!" }
     glProgramCheckBound(program)
@@ -181,6 +202,33 @@ internal fun glProgramSubmitLights(program: GlProgram, lights: List<Light>) {
     }
 }
 
+// uploaded once per frame, the shaders only walk the program
+internal fun glProgramSubmitSdf(program: GlProgram, sdf: SdfProgram) {
+    check(sdf.prims.size <= MAX_SDF_PRIMS) { "More sdf primitives than defined in shader!" }
+    check(sdf.ops.size <= MAX_SDF_OPS) { "More sdf operations than defined in shader!" }
+    glProgramCheckBound(program)
+    sdf.prims.forEachIndexed { index, prim ->
+        glProgramArrayUniform(program, "uSdfPrims[%d].type",       index, prim.shape.ordinal)
+        glProgramArrayUniform(program, "uSdfPrims[%d].params",     index, prim.params)
+        glProgramArrayUniform(program, "uSdfPrims[%d].transform",  index, prim.transform)
+        glProgramArrayUniform(program, "uSdfPrims[%d].repeat",     index, vec4(prim.repeat, 0f))
+        glProgramArrayUniform(program, "uSdfPrims[%d].limit",      index, vec4(prim.limit, 0f))
+        glProgramArrayUniform(program, "uSdfPrims[%d].displace",   index, prim.displace)
+        glProgramArrayUniform(program, "uSdfPrims[%d].lipschitz",  index, sdfPrimLipschitz(prim))
+    }
+    val links = sdfProgramLinks(sdf)
+    sdf.ops.forEachIndexed { index, op ->
+        glProgramArrayUniform(program, "uSdfOps[%d].op",           index, op.type.ordinal)
+        glProgramArrayUniform(program, "uSdfOps[%d].index",        index, op.index)
+        glProgramArrayUniform(program, "uSdfOps[%d].blend",        index, op.blend)
+        glProgramArrayUniform(program, "uSdfOps[%d].bounds",       index, links[index].bounds)
+        glProgramArrayUniform(program, "uSdfOps[%d].polarity",     index, links[index].polarity)
+        glProgramArrayUniform(program, "uSdfOps[%d].outer",        index, links[index].outer)
+        glProgramArrayUniform(program, "uSdfOps[%d].inner",        index, links[index].inner)
+    }
+    glProgramUniform(program, "uSdfOpsCnt", sdf.ops.size)
+}
+
 internal fun glDrawTriangles(program: GlProgram, mesh: GlMesh) {
     glProgramCheckBound(program)
     glMeshCheckBound(mesh)
@@ -0,0 +1,146 @@
+package com.gzozulin.minigl.scene
+
+import com.gzozulin.minigl.api.*
+import kotlin.math.abs
+import kotlin.math.max
+import kotlin.math.sqrt
+
+// ordinals are the SDF_* and SDF_OP_* defines of the shaders
+enum class SdfShape { SPHERE, BOX, CYLINDER, CONE, PRISM, PLANE, TORUS, CAPSULE, ROUND_BOX, ELLIPSOID }
+enum class SdfOpType { PRIM, UNION, SUBTRACTION, INTERSECTION, SMOOTH_UNION, SMOOTH_SUBTRACTION, SMOOTH_INTERSECTION }
+
+// transform takes the world into the local space of the primitive, as in sdfPrimCreate
+data class SdfPrim(val shape: SdfShape,
+                   val params: vec4,
+                   val transform: mat4 = mat4(),
+                   val repeat: vec3 = vec3(),
+                   val limit: vec3 = vec3(),
+                   val displace: vec2 = vec2())
+
+data class SdfOp(val type: SdfOpType, val index: Int = 0, val blend: Float = 0f)
+
+// the scene as a postfix program: primitives push a distance, operators combine the two on top
+data class SdfProgram(val prims: List<SdfPrim>, val ops: List<SdfOp>)
+
+// what sdfPrepare adds to an op, the shaders only read it
+internal data class SdfOpLinks(val bounds: vec4, val polarity: Int, val outer: Int, val inner: Int)
+
+// same bound as sdfPrimLipschitz in raymarcher.c
+internal fun sdfPrimLipschitz(prim: SdfPrim): Float {
+    val c0 = prim.transform.transformDirection(vec3(1f, 0f, 0f))
+    val c1 = prim.transform.transformDirection(vec3(0f, 1f, 0f))
+    val c2 = prim.transform.transformDirection(vec3(0f, 0f, 1f))
+    val r0 = c0.dot(c0) + abs(c0.dot(c1)) + abs(c0.dot(c2))
+    val r1 = abs(c1.dot(c0)) + c1.dot(c1) + abs(c1.dot(c2))
+    val r2 = abs(c2.dot(c0)) + abs(c2.dot(c1)) + c2.dot(c2)
+    val stretch = sqrt(max(r0, max(r1, r2)))
+    val slope = 1f + abs(prim.displace.x * prim.displace.y) * sqrt(3f)
+    return slope * stretch
+}
+
+private fun sdfPrimExtent(prim: SdfPrim): vec3? {
+    val p = prim.params
+    val extent = when (prim.shape) {
+        SdfShape.SPHERE -> vec3(p.x)
+        SdfShape.BOX, SdfShape.ROUND_BOX, SdfShape.ELLIPSOID -> vec3(p.x, p.y, p.z)
+        SdfShape.CYLINDER -> vec3(p.y, p.y, p.x * 0.5f)
+        SdfShape.CONE -> vec3(p.z * p.x / p.y, p.z, p.z * p.x / p.y)
+        SdfShape.PRISM -> vec3(p.x * 0.866025f, p.x, p.y)
+        SdfShape.TORUS -> vec3(p.x + p.y, p.y, p.x + p.y)
+        SdfShape.CAPSULE -> vec3(p.y, p.x * 0.5f + p.y, p.y)
+        SdfShape.PLANE -> return null
+    }
+    val period = vec3(prim.repeat).absolute()
+    if ((period.x > 0f && prim.limit.x <= 0f) || (period.y > 0f && prim.limit.y <= 0f)
+            || (period.z > 0f && prim.limit.z <= 0f)) {
+        return null
+    }
+    return extent.add(vec3(abs(prim.displace.x))).add(period.mul(prim.limit))
+}
+
+// same sphere as sdfPrimBounds in raymarcher.c
+private fun sdfPrimBounds(prim: SdfPrim): vec4 {
+    sdfPrimExtent(prim) ?: return vec4(0f, 0f, 0f, Float.MAX_VALUE)
+    val p = prim.params
+    var radius = when (prim.shape) {
+        SdfShape.SPHERE -> p.x
+        SdfShape.CYLINDER -> vec2(p.x * 0.5f, p.y).length()
+        SdfShape.CONE -> vec2(p.z * p.x / p.y, p.z).length()
+        SdfShape.PRISM -> vec2(p.x, p.y).length()
+        SdfShape.TORUS -> p.x + p.y
+        SdfShape.CAPSULE -> p.x * 0.5f + p.y
+        SdfShape.ELLIPSOID -> max(p.x, max(p.y, p.z))
+        else -> vec3(p.x, p.y, p.z).length()
+    }
+    radius += abs(prim.displace.x) + vec3(prim.repeat).absolute().mul(prim.limit).length()
+    val inverse = mat4(prim.transform).invertAffine()
+    val scale = max(inverse.transformDirection(vec3(1f, 0f, 0f)).length(),
+        max(inverse.transformDirection(vec3(0f, 1f, 0f)).length(),
+            inverse.transformDirection(vec3(0f, 0f, 1f)).length()))
+    val center = inverse.getTranslation(vec3())
+    return vec4(center, radius * scale)
+}
+
+private fun sdfBoundsUnion(left: vec4, right: vec4): vec4 {
+    val between = vec3(right.x - left.x, right.y - left.y, right.z - left.z)
+    val dist = between.length()
+    if (dist + right.w <= left.w) {
+        return left
+    }
+    if (dist + left.w <= right.w) {
+        return right
+    }
+    val radius = (dist + left.w + right.w) * 0.5f
+    val center = vec3(left.x, left.y, left.z).add(between.mul((radius - left.w) / dist))
+    return vec4(center, radius)
+}
+
+// the port of sdfPrepare: links every primitive to the subtrees starting with it
+internal fun sdfProgramLinks(program: SdfProgram): List<SdfOpLinks> {
+    val ops = program.ops
+    val bounds = Array(ops.size) { vec4() }
+    val outers = IntArray(ops.size) { -1 }
+    val inners = IntArray(ops.size) { -1 }
+    val stack = mutableListOf<vec4>()
+    val begins = mutableListOf<Int>()
+    ops.forEachIndexed { i, op ->
+        if (op.type == SdfOpType.PRIM) {
+            stack.add(sdfPrimBounds(program.prims[op.index]))
+            begins.add(i)
+            outers[i] = i
+        } else {
+            val right = stack.removeAt(stack.lastIndex)
+            begins.removeAt(begins.lastIndex)
+            val left = stack.last()
+            stack[stack.lastIndex] = when (op.type) {
+                SdfOpType.UNION -> sdfBoundsUnion(left, right)
+                SdfOpType.SMOOTH_UNION -> {
+                    val merged = sdfBoundsUnion(left, right)
+                    vec4(merged.x, merged.y, merged.z, merged.w + op.blend * 0.25f)
+                }
+                SdfOpType.SUBTRACTION, SdfOpType.SMOOTH_SUBTRACTION -> right
+                else -> if (left.w < right.w) left else right
+            }
+            val begin = begins.last()
+            inners[i] = outers[begin]
+            outers[begin] = i
+        }
+        bounds[i] = vec4(stack.last())
+    }
+
+    // polarity flows from the root, the operands of a smooth operator grow by its radius
+    val polarities = IntArray(ops.size)
+    val pending = mutableListOf(1 to 0f)
+    for (i in ops.indices.reversed()) {
+        val (polarity, blend) = pending.removeAt(pending.lastIndex)
+        polarities[i] = polarity
+        bounds[i].w += blend
+        val op = ops[i]
+        if (op.type != SdfOpType.PRIM) {
+            val subtraction = op.type == SdfOpType.SUBTRACTION || op.type == SdfOpType.SMOOTH_SUBTRACTION
+            pending.add((if (subtraction) -polarity else polarity) to op.blend)
+            pending.add(polarity to op.blend)
+        }
+    }
+    return ops.indices.map { SdfOpLinks(bounds[it], polarities[it], outers[it], inners[it]) }
+}
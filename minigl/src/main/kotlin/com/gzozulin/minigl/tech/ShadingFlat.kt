@@ -3,6 +3,7 @@ package com.gzozulin.minigl.tech
 import com.gzozulin.minigl.api.*
 import com.gzozulin.minigl.scene.Camera
 import com.gzozulin.minigl.scene.ControllerFirstPerson
+import com.gzozulin.minigl.scene.SdfProgram
 import com.gzozulin.minigl.scene.WasdInput
 
 private val vertexSrc = """
@@ -55,6 +56,13 @@ fun glShadingFlatDraw(shadingFlat: ShadingFlat, callback: Callback) {
     }
 }
 
+fun glShadingFlatDraw(shadingFlat: ShadingFlat, sdf: SdfProgram, callback: Callback) {
+    glProgramBind(shadingFlat.program) {
+        glProgramSubmitSdf(shadingFlat.program, sdf)
+        callback.invoke()
+    }
+}
+
 fun glShadingFlatInstance(shadingFlat: ShadingFlat, mesh: GlMesh) {
     shadingFlat.matrix.submit(shadingFlat.program)
     shadingFlat.color.submit(shadingFlat.program)
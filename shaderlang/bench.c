@@ -0,0 +1,384 @@
+//
+// Created by greg on 2021-08-24.
+//
+
+#include "lang.h"
+
+#include <assert.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// region ------------------- BENCH ---------------
+
+// Fixed scenes and seeds for every kernel, so numbers are comparable between commits.
+// Prints CSV by default, --json for a JSON array, --quick runs a tenth of the ops.
+
+#define BENCH_SEED 7.0f
+#define BENCH_RAYS 4096
+
+typedef struct BenchResult {
+    const char *kernel;
+    const char *unit;
+    long ops;
+    double seconds;
+} BenchResult;
+
+volatile float benchSink;
+
+float error() {
+    assert(0 && "WTF?!");
+}
+
+static double benchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void benchReport(const BenchResult *result, const bool json, const bool first) {
+    const double nsPerOp = result->seconds * 1e9 / (double) result->ops;
+    const double opsPerSec = (double) result->ops / result->seconds;
+    if (json) {
+        printf("%s  {\"kernel\": \"%s\", \"unit\": \"%s\", \"ops\": %ld, \"seconds\": %.6f, "
+               "\"ns_per_op\": %.3f, \"ops_per_sec\": %.1f}", first ? "" : ",\n",
+               result->kernel, result->unit, result->ops, result->seconds, nsPerOp, opsPerSec);
+    } else {
+        printf("%s,%s,%ld,%.6f,%.3f,%.1f\n",
+               result->kernel, result->unit, result->ops, result->seconds, nsPerOp, opsPerSec);
+    }
+    fflush(stdout);
+}
+
+static void benchRays(ray *rays, const int count) {
+    for (int i = 0; i < count; i++) {
+        const float fi = itof(i);
+        const vec3 target = mulv3f(subv3f(v3(rndv2(v2(BENCH_SEED, fi)), rndv2(v2(fi, BENCH_SEED)), 0.0f), 0.5f),
+                                   100.0f);
+        const ray r = { v3(0.0f, 0.0f, 150.0f), normv3(subv3(target, v3(0.0f, 0.0f, 150.0f))) };
+        rays[i] = r;
+    }
+}
+
+static BenchResult benchRayHitSphere(const long ops) {
+    static ray rays[BENCH_RAYS];
+    benchRays(rays, BENCH_RAYS);
+    const Sphere sphere = { v3zero(), 30.0f, MATERIAL_LAMBERTIAN, 0 };
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        sink += rayHitSphere(rays[i % BENCH_RAYS], BOUNCE_ERR, FLT_MAX, sphere).t;
+    }
+    const BenchResult result = { "rayHitSphere", "rays", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+static BenchResult benchRayHitBvh(const long ops, const bool wide) {
+    static ray rays[BENCH_RAYS];
+    benchRays(rays, BENCH_RAYS);
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const ray r = rays[i % BENCH_RAYS];
+        sink += wide ? rayHitBvhWide(bvhWideNodes, r, BOUNCE_ERR, FLT_MAX).t : rayHitBvh(r, BOUNCE_ERR, FLT_MAX, 0).t;
+    }
+    const BenchResult result = { wide ? "rayHitBvhWide" : "rayHitBvh", "rays", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+static BenchResult benchRaytracer(const int width, const int height, const bool wavefront) {
+    const RtParams params = {
+            width, height, 4, 4,
+            v3(0, 0, 150.0f), v3zero(), v3up(),
+            60.0f * PI / 180.0f, itof(width) / itof(height), 0, 1,
+            BENCH_SEED, wavefront };
+
+    vec4 *pixels = malloc(sizeof(vec4) * width * height);
+    const double start = benchNow();
+    raytracerRender(&params, pixels, NULL, 1);
+    const BenchResult result = {
+            wavefront ? "raytracerWave" : "raytracerRender", "samples",
+            (long) width * height * params.samples, benchNow() - start };
+    benchSink = pixels[0].x;
+    free(pixels);
+    return result;
+}
+
+static RaymarcherScene benchScene() {
+    const float piHalf = PI / 2.0f;
+    const RaymarcherScene scene = {
+            5.0f, 3.5f, translatem4(v3(0, 0, 0)),
+            v2(8, 8), 4.0f, mulm4(rotatem4(v3(1, 0, 0), piHalf), translatem4(v3(0, 0, -1))),
+            3.5f, 4.0f, translatem4(v3(0, 0, 0.2f)),
+            v3(5, 5, 4), translatem4(v3(0, 0, -6)),
+            v3(8, 4.5f, 3.9f), translatem4(v3(0, 0, -6)),
+            v2(2, 5), mulm4(rotatem4(v3(0, 1, 0), piHalf), translatem4(v3(0, -4.5f, -6))),
+            9.0f, 3.0f, mulm4(rotatem4(v3(1, 0, 0), piHalf), translatem4(v3(-7, 0, -5.5f))),
+            v3(10, 10, 2), mulm4(rotatem4(v3(0, 1, 0), piHalf / 2.0f), translatem4(v3(-11.5f, -5, -8))) };
+    return scene;
+}
+
+static BenchResult benchSceneDist(const long ops) {
+    sdfLoadScene(benchScene());
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        sink += sceneDist(v3(rndf(fi) * 30.0f - 15.0f, rndf(fi + 0.5f) * 30.0f - 15.0f, 5.0f));
+    }
+    const BenchResult result = { "sceneDist", "evals", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+// 441 spheres from one repeated primitive, blended into the floor
+static BenchResult benchSceneDistRepeat(const long ops) {
+    const SdfPrim sphere = sdfPrimCreate(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), m4ident());
+    uSdfPrims[0] = sdfPrimRepeat(sphere, v3(3.0f, 0.0f, 3.0f), v3(10.0f, 0.0f, 10.0f));
+    uSdfPrims[1] = sdfPrimPlaced(SDF_PLANE, v4zero(), translatem4(v3(0.0f, -1.0f, 0.0f)));
+    uSdfOps[0] = sdfOpCreate(SDF_OP_PRIM, 0);
+    uSdfOps[1] = sdfOpCreate(SDF_OP_PRIM, 1);
+    uSdfOps[2] = sdfOpSmooth(SDF_OP_SMOOTH_UNION, 0.5f);
+    uSdfOpsCnt = 3;
+    sdfPrepare();
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        sink += sceneDist(v3(rndf(fi) * 60.0f - 30.0f, rndf(fi + 0.25f) * 2.0f, rndf(fi + 0.5f) * 60.0f - 30.0f));
+    }
+    const BenchResult result = { "sceneDistRepeat", "evals", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+static BenchResult benchNormal(const long ops, const bool analytic) {
+    sdfLoadScene(benchScene());
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        const vec3 p = v3(rndf(fi) * 30.0f - 15.0f, rndf(fi + 0.5f) * 30.0f - 15.0f, 5.0f);
+        sink += analytic ? getNormalAnalytic(p).x : getNormal(p).x;
+    }
+    const BenchResult result = { analytic ? "getNormalAnalytic" : "getNormal", "normals", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+static BenchResult benchLight(const long ops, const int shadow) {
+    sdfLoadScene(benchScene());
+    const vec3 eye = v3(12.0f, 12.0f, 20.0f);
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        const vec3 p = v3(rndf(fi) * 20.0f - 10.0f, rndf(fi + 0.5f) * 20.0f - 10.0f, -5.0f);
+        sink += getLightMode(p, eye, shadow);
+    }
+    const BenchResult result = { shadow == SHADOW_SOFT ? "getLightSoft" : "getLight", "fragments", ops,
+                                 benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+static BenchResult benchRayMarch(const long ops) {
+    sdfLoadScene(benchScene());
+    const vec3 eye = v3(12.0f, 12.0f, 20.0f);
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        const vec3 target = v3(rndf(fi) * 20.0f - 10.0f, rndf(fi + 0.5f) * 20.0f - 10.0f, -5.0f);
+        sink += rayMarch(eye, normv3(subv3(target, eye)));
+    }
+    const BenchResult result = { "rayMarch", "rays", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+static BenchResult benchRayMarchRelaxed(const long ops) {
+    sdfLoadScene(benchScene());
+    const vec3 eye = v3(12.0f, 12.0f, 20.0f);
+    const float pixelRadius = tanf(PI / 6.0f) / 480.0f;
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        const vec3 target = v3(rndf(fi) * 20.0f - 10.0f, rndf(fi + 0.5f) * 20.0f - 10.0f, -5.0f);
+        sink += rayMarchMode(eye, normv3(subv3(target, eye)), MARCH_RELAXED, pixelRadius).t;
+    }
+    const BenchResult result = { "rayMarchRelaxed", "rays", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+static BenchResult benchRayMarchCache(const long ops) {
+    sdfLoadScene(benchScene());
+    SdfCache cache;
+    if (!sdfCacheBake(&cache, v3(-20.0f, -20.0f, -20.0f), v3(20.0f, 20.0f, 20.0f), 0.25f, parallelThreads())) {
+        fprintf(stderr, "Error baking the scene!\n");
+        exit(1);
+    }
+    const vec3 eye = v3(12.0f, 12.0f, 20.0f);
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        const vec3 target = v3(rndf(fi) * 20.0f - 10.0f, rndf(fi + 0.5f) * 20.0f - 10.0f, -5.0f);
+        sink += rayMarchCache(&cache, eye, normv3(subv3(target, eye)));
+    }
+    const BenchResult result = { "rayMarchCache", "rays", ops, benchNow() - start };
+    benchSink = sink;
+    sdfCacheFree(&cache);
+    return result;
+}
+
+static BenchResult benchRaymarcher(const int width, const int height, const bool adaptive) {
+    sdfLoadScene(benchScene());
+    const RmParams params = {
+            width, height, 4,
+            v3(12.0f, 12.0f, 20.0f), v3zero(),
+            60.0f * PI / 180.0f, itof(width) / itof(height),
+            MARCH_PLAIN, SHADOW_HARD, adaptive };
+
+    vec4 *pixels = malloc(sizeof(vec4) * width * height);
+    const double start = benchNow();
+    raymarcherRender(&params, pixels, NULL, 1);
+    const BenchResult result = {
+            adaptive ? "raymarcherAdaptive" : "raymarcherRender", "pixels",
+            (long) width * height, benchNow() - start };
+    benchSink = pixels[0].x;
+    free(pixels);
+    return result;
+}
+
+static BenchResult benchShadingPhong(const long ops) {
+    const PhongMaterial material = { v3(0.1f, 0.1f, 0.1f), v3(0.7f, 0.6f, 0.5f), v3one(), 32.0f, 1.0f };
+
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        const vec3 normal = normv3(v3(rndf(fi) - 0.5f, 1.0f, rndf(fi + 0.5f) - 0.5f));
+        sink += shadingPhong(v3(fi * 0.001f, 0.0f, 0.0f), v3(0.0f, 5.0f, 5.0f), normal, v3one(), material).x;
+    }
+    const BenchResult result = { "shadingPhong", "fragments", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+static BenchResult benchShadingPbr(const long ops) {
+    float sink = 0.0f;
+    const double start = benchNow();
+    for (long i = 0; i < ops; i++) {
+        const float fi = itof((int) (i % BENCH_RAYS));
+        const vec3 normal = normv3(v3(rndf(fi) - 0.5f, 1.0f, rndf(fi + 0.5f) - 0.5f));
+        sink += shadingPbr(v3(0.0f, 5.0f, 5.0f), v3(fi * 0.001f, 0.0f, 0.0f), v3(0.8f, 0.5f, 0.3f), normal,
+                           0.5f, 0.4f, 1.0f).x;
+    }
+    const BenchResult result = { "shadingPbr", "fragments", ops, benchNow() - start };
+    benchSink = sink;
+    return result;
+}
+
+// the passes over a real grid, the steps swap the buffers on top: both passes or the blocks
+static BenchResult benchSand(const int width, const int height, const int pass) {
+    SandGrid grid;
+    if (!sandGridCreate(&grid, width, height)) {
+        printf("Not enough memory for the sandbox!\n");
+        exit(1);
+    }
+    grid.mode = pass == 3 ? SAND_STEP_MARGOLUS : SAND_STEP_SOLVER;
+    sandGridScatter(&grid, 0.3f);
+    sandGridPhysics(&grid, parallelThreads());
+
+    const int steps = 4;
+    const double start = benchNow();
+    for (int i = 0; i < steps; i++) {
+        if (pass == 0) {
+            sandGridPhysics(&grid, parallelThreads());
+        } else if (pass == 1) {
+            sandGridSolve(&grid, parallelThreads());
+        } else {
+            sandGridStep(&grid, parallelThreads());
+        }
+    }
+    const char *names[] = { "sandPhysics", "sandSolver", "sandStep", "sandMargolus" };
+    const BenchResult result = { names[pass], "cells", (long) width * height * steps, benchNow() - start };
+    benchSink = itof(grid.cells[0]);
+    sandGridFree(&grid);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    long scale = 10;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            scale = 1;
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    static Sphere spheres[MAX_SPHERES];
+    bvhRandomSpheres(spheres, MAX_SPHERES, 100.0f, BENCH_SEED);
+    if (!bvhUpload(spheres, MAX_SPHERES)) {
+        fprintf(stderr, "Error uploading the scene!\n");
+        return 1;
+    }
+    bvhUploadWide();
+
+    BenchResult results[22];
+    int count = 0;
+    results[count++] = benchRayHitSphere(scale * 1000000);
+    results[count++] = benchRayHitBvh(scale * 100000, false);
+    results[count++] = benchRayHitBvh(scale * 100000, true);
+    results[count++] = benchRaytracer(64 * ftoi(sqrtf(itof(scale))), 48 * ftoi(sqrtf(itof(scale))), false);
+    results[count++] = benchRaytracer(64 * ftoi(sqrtf(itof(scale))), 48 * ftoi(sqrtf(itof(scale))), true);
+    results[count++] = benchSceneDist(scale * 100000);
+    results[count++] = benchSceneDistRepeat(scale * 100000);
+    results[count++] = benchNormal(scale * 50000, false);
+    results[count++] = benchNormal(scale * 50000, true);
+    results[count++] = benchRayMarch(scale * 2000);
+    results[count++] = benchLight(scale * 2000, SHADOW_HARD);
+    results[count++] = benchLight(scale * 2000, SHADOW_SOFT);
+    results[count++] = benchRayMarchRelaxed(scale * 2000);
+    results[count++] = benchRayMarchCache(scale * 2000);
+    results[count++] = benchRaymarcher(32 * ftoi(sqrtf(itof(scale))), 24 * ftoi(sqrtf(itof(scale))), false);
+    results[count++] = benchRaymarcher(32 * ftoi(sqrtf(itof(scale))), 24 * ftoi(sqrtf(itof(scale))), true);
+    results[count++] = benchShadingPhong(scale * 200000);
+    results[count++] = benchShadingPbr(scale * 200000);
+    results[count++] = benchSand(scale * 64, 256, 0);
+    results[count++] = benchSand(scale * 64, 256, 1);
+    results[count++] = benchSand(scale * 64, 256, 2);
+    results[count++] = benchSand(scale * 64, 256, 3);
+
+    printf(json ? "[\n" : "kernel,unit,ops,seconds,ns_per_op,ops_per_sec\n");
+    for (int i = 0; i < count; i++) {
+        benchReport(&results[i], json, i == 0);
+    }
+    if (json) {
+        printf("\n]\n");
+    }
+    return 0;
+}
+
+// endregion ------------------- BENCH ---------------
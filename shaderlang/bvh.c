@@ -0,0 +1,419 @@
+//
+// Created by greg on 2021-08-22.
+//
+
+#include "lang.h"
+
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// region ------------------- BVH ---------------
+
+#define BVH_BINS 12
+
+typedef struct BvhBuild {
+    const Sphere *spheres;
+    int *indices;
+    vec3 *centroids;
+    BvhNode *nodes;
+    int nodesCnt;
+} BvhBuild;
+
+typedef struct BvhBin {
+    aabb bounds;
+    int count;
+} BvhBin;
+
+static aabb aabbEmpty() {
+    const aabb result = { ftov3(FLT_MAX), ftov3(-FLT_MAX) };
+    return result;
+}
+
+static aabb aabbUnion(const aabb left, const aabb right) {
+    const aabb result = { minv3(left.pointMin, right.pointMin), maxv3(left.pointMax, right.pointMax) };
+    return result;
+}
+
+static aabb aabbSphere(const Sphere sphere) {
+    const aabb result = { subv3f(sphere.center, sphere.radius), addv3(sphere.center, ftov3(sphere.radius)) };
+    return result;
+}
+
+static float aabbArea(const aabb box) {
+    if (box.pointMin.x > box.pointMax.x) {
+        return 0.0f;
+    }
+    const vec3 d = subv3(box.pointMax, box.pointMin);
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static int bvhBuildNode(BvhBuild *build, const int begin, const int end) {
+    const int index = build->nodesCnt++;
+
+    aabb bounds = aabbEmpty();
+    aabb centers = aabbEmpty();
+    for (int i = begin; i < end; i++) {
+        const int sphere = build->indices[i];
+        bounds = aabbUnion(bounds, aabbSphere(build->spheres[sphere]));
+        const aabb center = { build->centroids[sphere], build->centroids[sphere] };
+        centers = aabbUnion(centers, center);
+    }
+
+    if (end - begin == 1) {
+        const BvhNode leaf = { bounds, HITABLE_SPHERE, build->indices[begin], -1, -1 };
+        build->nodes[index] = leaf;
+        return index;
+    }
+
+    const vec3 extent = subv3(centers.pointMax, centers.pointMin);
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    const float axisMin = indexv3(centers.pointMin, axis);
+    const float axisExtent = indexv3(extent, axis);
+
+    int mid = (begin + end) / 2; // all centroids coincide - any split will do
+    if (axisExtent > 0.0f) {
+        BvhBin bins[BVH_BINS];
+        for (int i = 0; i < BVH_BINS; i++) {
+            bins[i].bounds = aabbEmpty();
+            bins[i].count = 0;
+        }
+        const float scale = itof(BVH_BINS) / axisExtent;
+        for (int i = begin; i < end; i++) {
+            const int sphere = build->indices[i];
+            int bin = ftoi((indexv3(build->centroids[sphere], axis) - axisMin) * scale);
+            bin = bin < BVH_BINS ? bin : BVH_BINS - 1;
+            bins[bin].bounds = aabbUnion(bins[bin].bounds, aabbSphere(build->spheres[sphere]));
+            bins[bin].count++;
+        }
+
+        // sweep from the right to know the cost of every split in one pass from the left
+        float rightArea[BVH_BINS];
+        int rightCount[BVH_BINS];
+        aabb accum = aabbEmpty();
+        int count = 0;
+        for (int i = BVH_BINS - 1; i > 0; i--) {
+            accum = aabbUnion(accum, bins[i].bounds);
+            count += bins[i].count;
+            rightArea[i] = aabbArea(accum);
+            rightCount[i] = count;
+        }
+
+        float bestCost = FLT_MAX;
+        int bestSplit = 1;
+        accum = aabbEmpty();
+        count = 0;
+        for (int i = 1; i < BVH_BINS; i++) {
+            accum = aabbUnion(accum, bins[i - 1].bounds);
+            count += bins[i - 1].count;
+            if (count == 0 || rightCount[i] == 0) {
+                continue;
+            }
+            const float cost = aabbArea(accum) * itof(count) + rightArea[i] * itof(rightCount[i]);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+
+        int left = begin;
+        int right = end - 1;
+        while (left <= right) {
+            const int sphere = build->indices[left];
+            const int bin = ftoi((indexv3(build->centroids[sphere], axis) - axisMin) * scale);
+            if (bin < bestSplit) {
+                left++;
+            } else {
+                build->indices[left] = build->indices[right];
+                build->indices[right] = sphere;
+                right--;
+            }
+        }
+        mid = left;
+    }
+
+    const int leftIndex = bvhBuildNode(build, begin, mid);
+    const int rightIndex = bvhBuildNode(build, mid, end);
+    const BvhNode node = { bounds, HITABLE_BVH, leftIndex, HITABLE_BVH, rightIndex };
+    build->nodes[index] = node;
+    return index;
+}
+
+// returns the nodes written, 0 when there is nothing to build or no memory to build it with
+int bvhBuild(const Sphere *spheres, const int count, BvhNode *nodes) {
+    if (count <= 0) {
+        return 0;
+    }
+
+    BvhBuild build;
+    build.spheres = spheres;
+    build.indices = malloc(sizeof(int) * count);
+    build.centroids = malloc(sizeof(vec3) * count);
+    if (build.indices == NULL || build.centroids == NULL) {
+        free(build.indices);
+        free(build.centroids);
+        return 0;
+    }
+    build.nodes = nodes;
+    build.nodesCnt = 0;
+    for (int i = 0; i < count; i++) {
+        build.indices[i] = i;
+        build.centroids[i] = spheres[i].center;
+    }
+
+    bvhBuildNode(&build, 0, count);
+
+    free(build.indices);
+    free(build.centroids);
+    return build.nodesCnt;
+}
+
+int bvhDepth(const BvhNode *nodes, const int index) {
+    if (nodes[index].leftType != HITABLE_BVH) {
+        return 0;
+    }
+    const int left = bvhDepth(nodes, nodes[index].leftIndex);
+    const int right = bvhDepth(nodes, nodes[index].rightIndex);
+    return 1 + (left > right ? left : right);
+}
+
+bool bvhUpload(const Sphere *spheres, const int count) {
+    if (count <= 0 || count > MAX_SPHERES || 2 * count - 1 > MAX_BVH) {
+        return false;
+    }
+    BvhNode nodes[MAX_BVH];
+    if (bvhBuild(spheres, count, nodes) == 0) {
+        return false;
+    }
+    if (bvhDepth(nodes, 0) > BVH_STACK) {
+        return false; // rayHitBvh keeps one entry per inner ancestor
+    }
+    memcpy(uSpheres, spheres, sizeof(Sphere) * count);
+    memcpy(uBvhNodes, nodes, sizeof(BvhNode) * (2 * count - 1));
+    return true;
+}
+
+void bvhRandomSpheres(Sphere *spheres, const int count, const float extent, const float seed) {
+    for (int i = 0; i < count; i++) {
+        const float fi = itof(i);
+        const vec3 center = v3(rndv2(v2(seed, fi)), rndv3(v3(seed, fi, 1.0f)), rndv3(v3(seed, fi, 2.0f)));
+        spheres[i].center = mulv3f(subv3f(center, 0.5f), extent);
+        spheres[i].radius = extent * (0.005f + 0.02f * rndv3(v3(seed, fi, 3.0f)));
+        spheres[i].materialType = i % 3;
+        spheres[i].materialIndex = spheres[i].materialType == MATERIAL_LAMBERTIAN ? i % 2 : 0;
+    }
+}
+
+// endregion ------------------- BVH ---------------
+
+// region ------------------- WIDE BVH ---------------
+
+BvhWideNode bvhWideNodes[MAX_BVH];
+
+static void bvhWideSlot(BvhWideNode *node, const int slot, const aabb bounds, const int child) {
+    node->minX[slot] = bounds.pointMin.x;
+    node->minY[slot] = bounds.pointMin.y;
+    node->minZ[slot] = bounds.pointMin.z;
+    node->maxX[slot] = bounds.pointMax.x;
+    node->maxY[slot] = bounds.pointMax.y;
+    node->maxZ[slot] = bounds.pointMax.z;
+    node->child[slot] = child;
+}
+
+static int bvhCollapseNode(const BvhNode *nodes, const int index, BvhWideNode *wide, int *wideCnt) {
+    const int result = (*wideCnt)++;
+
+    // open the largest inner child until the node is full or only leaves are left
+    int children[BVH_WIDE] = { nodes[index].leftIndex, nodes[index].rightIndex };
+    int count = 2;
+    while (count < BVH_WIDE) {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (int i = 0; i < count; i++) {
+            const BvhNode child = nodes[children[i]];
+            if (child.leftType == HITABLE_BVH && aabbArea(child.aabb) > largestArea) {
+                largest = i;
+                largestArea = aabbArea(child.aabb);
+            }
+        }
+        if (largest < 0) {
+            break;
+        }
+        const BvhNode opened = nodes[children[largest]];
+        children[largest] = opened.leftIndex;
+        children[count++] = opened.rightIndex;
+    }
+
+    BvhWideNode node;
+    memset(&node, 0, sizeof(node));
+    node.count = count;
+    for (int i = 0; i < count; i++) {
+        const BvhNode child = nodes[children[i]];
+        const int slot = child.leftType == HITABLE_BVH
+                ? bvhCollapseNode(nodes, children[i], wide, wideCnt)
+                : -1 - child.leftIndex;
+        bvhWideSlot(&node, i, child.aabb, slot);
+    }
+    wide[result] = node;
+    return result;
+}
+
+int bvhCollapse(const BvhNode *nodes, BvhWideNode *wide) {
+    if (nodes[0].leftType != HITABLE_BVH) {
+        BvhWideNode node;
+        memset(&node, 0, sizeof(node));
+        node.count = 1;
+        bvhWideSlot(&node, 0, nodes[0].aabb, -1 - nodes[0].leftIndex);
+        wide[0] = node;
+        return 1;
+    }
+    int wideCnt = 0;
+    bvhCollapseNode(nodes, 0, wide, &wideCnt);
+    return wideCnt;
+}
+
+int bvhUploadWide() {
+    return bvhCollapse(uBvhNodes, bvhWideNodes);
+}
+
+#if defined(__SSE__)
+
+typedef struct BvhWideRay {
+    __m128 originX, originY, originZ;
+    __m128 invDX, invDY, invDZ;
+} BvhWideRay;
+
+static BvhWideRay bvhWideRay(const ray ray) {
+    const BvhWideRay result = {
+            _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z),
+            _mm_set1_ps(1.0f / ray.direction.x), _mm_set1_ps(1.0f / ray.direction.y),
+            _mm_set1_ps(1.0f / ray.direction.z) };
+    return result;
+}
+
+// slab test against all children at once, returns the mask of the hit ones
+static int bvhWideSlabs(const BvhWideNode *node, const BvhWideRay *r,
+                        const float tMin, const float tMax, float *tNear) {
+    const __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->minX), r->originX), r->invDX);
+    const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->maxX), r->originX), r->invDX);
+    const __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->minY), r->originY), r->invDY);
+    const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->maxY), r->originY), r->invDY);
+    const __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->minZ), r->originZ), r->invDZ);
+    const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node->maxZ), r->originZ), r->invDZ);
+
+    const __m128 near = _mm_max_ps(
+            _mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+            _mm_max_ps(_mm_min_ps(z0, z1), _mm_set1_ps(tMin)));
+    const __m128 far = _mm_min_ps(
+            _mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+            _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(tMax)));
+
+    _mm_storeu_ps(tNear, near);
+    return _mm_movemask_ps(_mm_cmpgt_ps(far, near)) & ((1 << node->count) - 1);
+}
+
+#else
+
+typedef struct BvhWideRay {
+    vec3 origin;
+    vec3 invD;
+} BvhWideRay;
+
+static BvhWideRay bvhWideRay(const ray ray) {
+    const BvhWideRay result = {
+            ray.origin, v3(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z) };
+    return result;
+}
+
+static float bvhWideAxis(const float min, const float max, const float origin, const float invD,
+                         float *near, const float far) {
+    const float t0 = (min - origin) * invD;
+    const float t1 = (max - origin) * invD;
+    *near = maxf(*near, minf(t0, t1));
+    return minf(far, maxf(t0, t1));
+}
+
+static int bvhWideSlabs(const BvhWideNode *node, const BvhWideRay *r,
+                        const float tMin, const float tMax, float *tNear) {
+    int mask = 0;
+    for (int i = 0; i < node->count; i++) {
+        float near = tMin;
+        float far = tMax;
+        far = bvhWideAxis(node->minX[i], node->maxX[i], r->origin.x, r->invD.x, &near, far);
+        far = bvhWideAxis(node->minY[i], node->maxY[i], r->origin.y, r->invD.y, &near, far);
+        far = bvhWideAxis(node->minZ[i], node->maxZ[i], r->origin.z, r->invD.z, &near, far);
+        tNear[i] = near;
+        if (far > near) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+#endif
+
+HitRecord rayHitBvhWide(const BvhWideNode *nodes, const ray ray, const float tMin, const float tMax) {
+    const BvhWideRay wideRay = bvhWideRay(ray);
+    float closest = tMax;
+    HitRecord result = NO_HIT;
+
+    // every node is pushed at most once
+    int stack[MAX_BVH];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const BvhWideNode *node = &nodes[stack[--top]];
+        float tNear[BVH_WIDE];
+        const int mask = bvhWideSlabs(node, &wideRay, tMin, closest, tNear);
+        if (mask == 0) {
+            continue;
+        }
+
+        // nearest first: spheres shrink the interval early, the closest node is popped next
+        int order[BVH_WIDE];
+        int hits = 0;
+        for (int i = 0; i < node->count; i++) {
+            if ((mask & (1 << i)) == 0) {
+                continue;
+            }
+            int j = hits++;
+            for (; j > 0 && tNear[order[j - 1]] > tNear[i]; j--) {
+                order[j] = order[j - 1];
+            }
+            order[j] = i;
+        }
+
+        for (int i = 0; i < hits; i++) {
+            const int child = node->child[order[i]];
+            if (child < 0 && tNear[order[i]] < closest) {
+                const HitRecord hit = rayHitSphere(ray, tMin, closest, uSpheres[-1 - child]);
+                if (hit.t > 0 && hit.t < closest) {
+                    result = hit;
+                    closest = hit.t;
+                }
+            }
+        }
+        for (int i = hits - 1; i >= 0; i--) {
+            const int child = node->child[order[i]];
+            if (child >= 0 && tNear[order[i]] < closest) {
+                stack[top++] = child;
+            }
+        }
+    }
+
+    return result;
+}
+
+// The host traces the collapsed tree, bvhUploadWide first. The shaders walk uBvhNodes with rayHitBvh,
+// their rayHitWorld is in GlCustom.kt.
+HitRecord rayHitWorld(const ray ray, const float tMin, const float tMax) {
+    return rayHitBvhWide(bvhWideNodes, ray, tMin, tMax);
+}
+
+// endregion ------------------- WIDE BVH ---------------
+
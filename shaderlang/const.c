@@ -25,20 +25,22 @@ const Light uLights[MAX_LIGHTS] = {
         { { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, 1.0f, 1.0f, 1.0f }
 };
 
-const BvhNode uBvhNodes[MAX_BVH] = {
+BvhNode uBvhNodes[MAX_BVH] = {
         { { { -100, -100,  -100 }, { 100, 100, 100 } }, HITABLE_BVH,     1, HITABLE_BVH,   2 },
         { { { -100, -100,  -100 }, {  0,   0,    0 } }, HITABLE_SPHERE,  0,   -1,         -1 },
         { { {    0,    0,     0 }, { 100, 100, 100 } }, HITABLE_SPHERE,  1,   -1,         -1 }
 };
 
-int bvhStack[MAX_BVH];
-int bvhTop = 0;
-
-const Sphere uSpheres[MAX_SPHERES] = {
+Sphere uSpheres[MAX_SPHERES] = {
         { { -50, -50, -50 }, 50, 0, 0 },
         { {  50,  50,  50 }, 50, 0, 1 }
 };
 
+// the program sceneDist walks - uniforms on the GPU, per thread here so that every tile worker holds a copy
+_Thread_local SdfPrim uSdfPrims[MAX_SDF_PRIMS];
+_Thread_local SdfOp uSdfOps[MAX_SDF_OPS];
+_Thread_local int uSdfOpsCnt = 0;
+
 const LambertianMaterial uLambertianMaterials[MAX_LAMBERTIANS] = {
         { { 1, 0, 0 } },
         { { 0, 1, 0 } }
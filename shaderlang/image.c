@@ -0,0 +1,112 @@
+//
+// Created by greg on 2021-08-21.
+//
+
+#include "lang.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// region ------------------- IMAGE ---------------
+
+static unsigned char imageChannel(const float value) {
+    const int result = (int) (255.9f * value);
+    return (unsigned char) (result < 0 ? 0 : (result > 255 ? 255 : result));
+}
+
+static void imageRgb(const vec4 *pixels, const int count, unsigned char *rgb) {
+    for (int i = 0; i < count; i++) {
+        rgb[i * 3 + 0] = imageChannel(pixels[i].x);
+        rgb[i * 3 + 1] = imageChannel(pixels[i].y);
+        rgb[i * 3 + 2] = imageChannel(pixels[i].z);
+    }
+}
+
+static bool imageWrite(const char *path, const char *header, const void *data, const size_t size) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    const bool result = fputs(header, f) >= 0 && fwrite(data, 1, size, f) == size;
+    return fclose(f) == 0 && result;
+}
+
+bool imageWritePpm(const char *path, const vec4 *pixels, const int width, const int height) {
+    const size_t size = (size_t) width * height * 3;
+    unsigned char *rgb = malloc(size);
+    if (rgb == NULL) {
+        return false;
+    }
+    imageRgb(pixels, width * height, rgb);
+    char header[64];
+    snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    const bool result = imageWrite(path, header, rgb, size);
+    free(rgb);
+    return result;
+}
+
+bool imageWritePfm(const char *path, const vec4 *pixels, const int width, const int height) {
+    // PFM goes bottom to top, negative scale stands for little-endian floats
+    const size_t size = sizeof(float) * width * height * 3;
+    float *rgb = malloc(size);
+    if (rgb == NULL) {
+        return false;
+    }
+    for (int y = 0; y < height; y++) {
+        const vec4 *row = &pixels[(height - 1 - y) * width];
+        for (int x = 0; x < width; x++) {
+            float *dst = &rgb[(y * width + x) * 3];
+            dst[0] = row[x].x;
+            dst[1] = row[x].y;
+            dst[2] = row[x].z;
+        }
+    }
+    char header[64];
+    snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", width, height);
+    const bool result = imageWrite(path, header, rgb, size);
+    free(rgb);
+    return result;
+}
+
+bool imageStreamOpen(ImageStream *stream, const char *path, const int width, const int height) {
+    char header[64];
+    const int headerLen = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    stream->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    stream->width = width;
+    stream->height = height;
+    stream->offset = headerLen;
+    if (stream->fd < 0) {
+        return false;
+    }
+    const off_t size = headerLen + (off_t) width * height * 3;
+    if (write(stream->fd, header, headerLen) != headerLen || ftruncate(stream->fd, size) != 0) {
+        close(stream->fd);
+        return false;
+    }
+    return true;
+}
+
+bool imageStreamTile(const ImageStream *stream, const vec4 *pixels, const int x0, const int y0, const int x1, const int y1) {
+    // rows of a tile land at their final offsets - tiles can complete in any order, from any thread
+    const int count = x1 - x0;
+    unsigned char *rgb = malloc((size_t) count * 3);
+    if (rgb == NULL) {
+        return false;
+    }
+    bool result = true;
+    for (int y = y0; y < y1 && result; y++) {
+        imageRgb(&pixels[y * stream->width + x0], count, rgb);
+        const off_t at = stream->offset + ((off_t) y * stream->width + x0) * 3;
+        result = pwrite(stream->fd, rgb, (size_t) count * 3, at) == count * 3;
+    }
+    free(rgb);
+    return result;
+}
+
+bool imageStreamClose(ImageStream *stream) {
+    return close(stream->fd) == 0;
+}
+
+// endregion ------------------- IMAGE ---------------
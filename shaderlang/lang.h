@@ -19,6 +19,7 @@
 
 #define MAX_LIGHTS              128
 #define MAX_BVH                 512
+#define BVH_STACK               64
 #define MAX_SPHERES             256
 #define MAX_LAMBERTIANS         16
 #define MAX_METALS              16
@@ -31,6 +32,35 @@
 #define MATERIAL_METALIIC       1
 #define MATERIAL_DIELECTRIC     2
 
+#define MAX_SDF_PRIMS           32
+#define MAX_SDF_OPS             64
+#define SDF_STACK               16
+
+#define SDF_SPHERE              0
+#define SDF_BOX                 1
+#define SDF_CYLINDER            2
+#define SDF_CONE                3
+#define SDF_PRISM               4
+#define SDF_PLANE               5
+#define SDF_TORUS               6
+#define SDF_CAPSULE             7
+#define SDF_ROUND_BOX           8
+#define SDF_ELLIPSOID           9
+
+#define SDF_OP_PRIM                 0
+#define SDF_OP_UNION                1
+#define SDF_OP_SUBTRACTION          2
+#define SDF_OP_INTERSECTION         3
+#define SDF_OP_SMOOTH_UNION         4
+#define SDF_OP_SMOOTH_SUBTRACTION   5
+#define SDF_OP_SMOOTH_INTERSECTION  6
+
+#define MARCH_PLAIN             0
+#define MARCH_RELAXED           1
+
+#define SHADOW_HARD             0
+#define SHADOW_SOFT             1
+
 // endregion ------------------- DEFINE -------------------
 
 // region ------------------- TYPES -------------------
@@ -52,7 +82,7 @@ typedef struct vec3 {
 } vec3;
 
 typedef struct vec4 {
-    float x;
+    _Alignas(16) float x; // one SSE register on the host
     float y;
     float z;
     float w;
@@ -63,7 +93,7 @@ typedef struct mat2 {
 } mat2;
 
 typedef struct mat4 {
-    float value[16];
+    float value[16]; // column-major, as in GLSL
 } mat4;
 
 typedef struct sampler2D {
@@ -171,6 +201,46 @@ typedef struct RefractResult {
     vec3 refracted;
 } RefractResult;
 
+public
+typedef struct MarchResult {
+    float t;
+    int steps;
+} MarchResult;
+
+// host only, sdfLoadScene turns it into the program the shaders get as uniforms
+typedef struct RaymarcherScene {
+    float cylALen;      float cylARad;      mat4 cylAMat;
+    vec2 coneBShape;    float coneBHeight;  mat4 coneBMat;
+    float cylCLen;      float cylCRad;      mat4 cylCMat;
+    vec3 boxDShape;     mat4 boxDMat;
+    vec3 boxEShape;     mat4 boxEMat;
+    vec2 prismFShape;   mat4 prismFMat;
+    float cylGLen;      float cylGRad;      mat4 cylGMat;
+    vec3 boxHShape;     mat4 boxHMat;
+} RaymarcherScene;
+
+public
+typedef struct SdfPrim {
+    int type;
+    vec4 params;
+    mat4 transform;
+    vec4 repeat;        // period along the local axes, 0 keeps the axis single
+    vec4 limit;         // copies on either side of the origin, 0 repeats without a limit
+    vec2 displace;      // amplitude and frequency of the sine displacement
+    float lipschitz;    // the distance is divided by it to remain a bound
+} SdfPrim;
+
+public
+typedef struct SdfOp {
+    int op;
+    int index;
+    float blend;    // radius of the smooth operators
+    vec4 bounds;    // sphere around the subtree ending here
+    int polarity;   // -1 when the subtree is subtracted an odd number of times
+    int outer;      // for a primitive: the largest subtree starting here
+    int inner;      // the next smaller subtree with the same start
+} SdfOp;
+
 // endregion ------------------- TYPES -------------------
 
 float error();
@@ -181,6 +251,18 @@ void printv3(vec3 v);
 extern const float                  PI;
 extern const float                  BOUNCE_ERR;
 
+extern const int                    MAX_STEPS;
+extern const float                  MAX_DIST;
+extern const float                  MIN_DIST;
+extern const float                  CULL_DIST;
+extern const float                  MARCH_RELAXATION;
+extern const float                  SHADOW_SOFTNESS;
+
+extern const int                    TYPE_EMPTY;
+extern const int                    TYPE_SAND;
+extern const int                    TYPE_WATER;
+extern const int                    TYPE_WALL;
+
 extern const HitRecord              NO_HIT;
 extern const ScatterResult          NO_SCATTER;
 extern const RefractResult          NO_REFRACT;
@@ -189,11 +271,13 @@ extern const int                    uLightsPointCnt;
 extern const int                    uLightsDirCnt;
 extern const Light                  uLights[];
 
-extern const BvhNode                uBvhNodes[];
-extern int                          bvhStack[];
-extern int                          bvhTop;
+extern BvhNode                      uBvhNodes[];
+
+extern Sphere                       uSpheres[];
 
-extern const Sphere                 uSpheres[];
+extern _Thread_local SdfPrim        uSdfPrims[];
+extern _Thread_local SdfOp          uSdfOps[];
+extern _Thread_local int            uSdfOpsCnt;
 
 extern const LambertianMaterial     uLambertianMaterials[];
 extern const MetallicMaterial       uMetallicMaterials  [];
@@ -393,6 +477,8 @@ mat4 m4ident();
 
 mat4 mulm4(mat4 left, mat4 right);
 vec4 transformv4(vec4 vec, mat4 mat);
+vec3 affinev3(vec3 vec, mat4 mat);
+mat4 inversem4Affine(mat4 mat);
 
 mat4 translatem4(vec3 vec);
 mat4 rotatem4(vec3 axis, float angle);
@@ -409,13 +495,155 @@ float sdCappedCylinder(vec3 p, vec3 a, vec3 b, float r);
 float sdSimplifiedCyl(vec3 p, float cylLen, float cylRad);
 float sdCone(vec3 p, vec2 c, float h);
 float sdTriPrism(vec3 p, vec2 h);
+float sdTorus(vec3 p, vec2 t);
+float sdCapsule(vec3 p, vec3 a, vec3 b, float r);
+float sdRoundBox(vec3 p, vec3 b, float r);
+float sdEllipsoid(vec3 p, vec3 r);
 
 float opUnion(float d1, float d2);
 float opSubtraction(float d1, float d2);
 float opIntersection(float d1, float d2);
+float opSmoothUnion(float d1, float d2, float k);
+float opSmoothSubtraction(float d1, float d2, float k);
+float opSmoothIntersection(float d1, float d2, float k);
+float opRepAxis(float p, float c, float l);
+vec3 opRep(vec3 p, vec3 c);
+vec3 opRepLim(vec3 p, vec3 c, vec3 l);
+float opDisplace(vec3 p, float d, vec2 displace);
 
 // endregion ------------------- SDFS -------------------
 
+// region ------------------- SHADING -------------------
+
+vec4 shadingPhong(vec3 fragPosition, vec3 eye, vec3 fragNormal, vec3 fragAlbedo, PhongMaterial material);
+vec4 shadingPbr(vec3 eye, vec3 worldPos, vec3 albedo, vec3 N, float metallic, float roughness, float ao);
+
+// endregion ------------------- SHADING -------------------
+
+// region ------------------- SANDSIM -------------------
+
+int sandPack(int type, ivec2 move, int seed);
+int sandType(int cell);
+ivec2 sandMove(int cell);
+int sandSeed(int cell);
+int sandCellAt(sampler2D orig, vec2 uv);
+float sandRnd(ivec2 cell, int frame, int material);
+vec4 sandConvert(vec4 pixel);
+vec4 sandPhysics(sampler2D orig, vec2 uv, ivec2 wh, int frame);
+vec4 sandSolver(sampler2D orig, sampler2D deltas, vec2 uv, ivec2 wh);
+vec4 sandMargolus(sampler2D orig, vec2 uv, ivec2 wh, int frame);
+vec4 sandDraw(sampler2D orig, vec2 uv, ivec2 wh);
+
+// endregion ------------------- SANDSIM -------------------
+
+// region ------------------- SANDGRID -------------------
+
+#define SAND_STEP_SOLVER    0   // sandPhysics and sandSolver
+#define SAND_STEP_MARGOLUS  1   // sandMargolus in one pass
+
+#define SAND_CHUNK          16
+
+// host only: the sandsim textures as byte grids, a packed cell per byte - see sandPack
+typedef struct SandGrid {
+    int width;
+    int height;
+    int mode;
+    int frame;
+    int chunksX;
+    int chunksY;
+    int activeCnt;              // chunks in the last pass
+    unsigned char *cells;
+    unsigned char *next;        // the solver writes here, swapped with the cells after every step
+    unsigned char *deltas;      // the cells with the moves they want
+    unsigned char *changes;     // per chunk: changed in this step, the last one and the one before
+    int *active;
+} SandGrid;
+
+bool sandGridCreate(SandGrid *grid, int width, int height);
+void sandGridFree(SandGrid *grid);
+void sandGridWake(SandGrid *grid);
+void sandGridConvert(SandGrid *grid, const vec4 *pixels);
+void sandGridScatter(SandGrid *grid, float density);
+void sandGridPhysics(SandGrid *grid, int threadsCnt);
+void sandGridSolve(SandGrid *grid, int threadsCnt);
+void sandGridMargolus(SandGrid *grid, int threadsCnt);
+void sandGridStep(SandGrid *grid, int threadsCnt);
+void sandGridDraw(const SandGrid *grid, vec4 *pixels, int threadsCnt);
+void sandGridRun(int width, int height, int steps, int mode);
+
+// endregion ------------------- SANDGRID -------------------
+
+// region ------------------- RAYMARCHER -------------------
+
+// host only: a copy of the per thread program
+typedef struct SdfProgram {
+    SdfPrim prims[MAX_SDF_PRIMS];
+    SdfOp ops[MAX_SDF_OPS];
+    int opsCnt;
+} SdfProgram;
+
+#define RM_HISTOGRAM 10
+
+// host only: primary rays per tenth of MAX_STEPS
+typedef struct RmStats {
+    long rays;
+    long steps[RM_HISTOGRAM];
+} RmStats;
+
+typedef struct RmParams {
+    int width;
+    int height;
+    int samplesAA;
+    vec3 eye;
+    vec3 center;
+    float fovy;
+    float aspect;
+    int mode;
+    int shadow;
+    bool adaptive;
+} RmParams;
+
+float sdfPrimLipschitz(SdfPrim prim);
+SdfPrim sdfPrimCreate(int type, vec4 params, mat4 transform);
+SdfPrim sdfPrimPlaced(int type, vec4 params, mat4 placement);
+SdfPrim sdfPrimRepeat(SdfPrim prim, vec3 period, vec3 limit);
+SdfPrim sdfPrimDisplace(SdfPrim prim, float amplitude, float frequency);
+SdfOp sdfOpCreate(int op, int index);
+SdfOp sdfOpSmooth(int op, float blend);
+vec3 sdfPrimLocal(vec3 p, SdfPrim prim);
+float sdfPrimShape(vec3 local, SdfPrim prim);
+float sdfPrimDist(vec3 p, SdfPrim prim);
+vec4 sdfPrimGrad(vec3 p, SdfPrim prim);
+vec3 sdfPrimExtent(SdfPrim prim);
+aabb sdfPrimBox(SdfPrim prim);
+vec4 sdfPrimBounds(SdfPrim prim);
+vec4 sdfBoundsUnion(vec4 left, vec4 right);
+void sdfPrepare();
+void sdfLoadScene(RaymarcherScene scene);
+
+float sceneDist(vec3 p);
+vec4 sdfGradNeg(vec4 grad);
+vec4 sdfSmoothGrad(vec4 left, vec4 right, float k);
+vec4 sceneDistGrad(vec3 p);
+float rayMarch(vec3 ro, vec3 rd);
+float marchEpsilon(float t, float pixelRadius);
+MarchResult rayMarchMode(vec3 ro, vec3 rd, int mode, float pixelRadius);
+vec3 getNormal(vec3 p);
+vec3 getNormalAnalytic(vec3 p);
+float shadowSoft(vec3 ro, vec3 rd, float maxT);
+float getLightMode(vec3 p, vec3 eye, int shadow);
+float getLight(vec3 p, vec3 eye);
+vec4 raymarcherSdf(vec3 eye, vec3 center, vec2 uv, float fovy, float aspect, ivec2 wh, int samplesAA);
+vec4 raymarcherSdfMode(vec3 eye, vec3 center, vec2 uv, float fovy, float aspect, ivec2 wh, int samplesAA, int mode,
+                       int shadow);
+
+void sdfProgramSave(SdfProgram *program);
+void sdfProgramLoad(const SdfProgram *program);
+int raymarcherRender(const RmParams *params, vec4 *pixels, RmStats *stats, int threadsCnt);
+void raymarcherRecipe(const char *path, bool adaptive);
+
+// endregion ------------------- RAYMARCHER -------------------
+
 // region ------------------- RAY -------------------
 
 ray rayBack();
@@ -440,6 +668,8 @@ float rndv4(vec4  v);
 
 vec3 seedRandom(vec3 s);
 float seededRndf();
+vec4 seedSave();
+void seedRestore(vec4 s);
 
 vec3 randomInUnitSphere() ;
 vec3 randomInUnitDisk();
@@ -448,8 +678,171 @@ vec3 randomInUnitDisk();
 
 // region ------------------- SAMPLER -------------------
 
+#define SAMPLER_HOST 8
+
+// host only: the texels behind a sampler handle, bytes as the integer texels on the GPU
+void samplerBind(sampler2D sampler, int width, int height, int channels, const unsigned char *texels);
+
 vec4 sampler(sampler2D sampler, vec2 texCoords);
 vec4 texel(samplerBuffer sampler, int index);
 vec4 samplerq(samplerCube sampler, vec3 texCoords);
 
 // endregion ------------------- SAMPLER -------------------
+
+// region ------------------- PARALLEL -------------------
+
+typedef void (*TileFunc)(int x0, int y0, int x1, int y1, void *context);
+
+int parallelThreads();
+void parallelTiles(int width, int height, int tileW, int tileH, int threadsCnt, TileFunc func, void *context);
+
+// endregion ------------------- PARALLEL -------------------
+
+// region ------------------- BVH -------------------
+
+#define BVH_WIDE 4
+
+// host only: the binary tree collapsed to BVH_WIDE children per node, bounds stored per axis
+typedef struct BvhWideNode {
+    _Alignas(16) float minX[BVH_WIDE];
+    float minY[BVH_WIDE];
+    float minZ[BVH_WIDE];
+    float maxX[BVH_WIDE];
+    float maxY[BVH_WIDE];
+    float maxZ[BVH_WIDE];
+    int child[BVH_WIDE]; // >= 0: wide node, < 0: sphere -1 - child
+    int count;
+} BvhWideNode;
+
+extern BvhWideNode                  bvhWideNodes[];
+
+int bvhBuild(const Sphere *spheres, int count, BvhNode *nodes);
+int bvhDepth(const BvhNode *nodes, int index);
+bool bvhUpload(const Sphere *spheres, int count);
+void bvhRandomSpheres(Sphere *spheres, int count, float extent, float seed);
+
+int bvhCollapse(const BvhNode *nodes, BvhWideNode *wide);
+int bvhUploadWide();
+HitRecord rayHitBvhWide(const BvhWideNode *nodes, ray ray, float tMin, float tMax);
+HitRecord rayHitWorld(ray ray, float tMin, float tMax);
+
+// endregion ------------------- BVH -------------------
+
+// region ------------------- IMAGE -------------------
+
+typedef struct ImageStream {
+    int fd;
+    int width;
+    int height;
+    long offset;
+} ImageStream;
+
+bool imageWritePpm(const char *path, const vec4 *pixels, int width, int height);
+bool imageWritePfm(const char *path, const vec4 *pixels, int width, int height);
+
+bool imageStreamOpen(ImageStream *stream, const char *path, int width, int height);
+bool imageStreamTile(const ImageStream *stream, const vec4 *pixels, int x0, int y0, int x1, int y1);
+bool imageStreamClose(ImageStream *stream);
+
+// endregion ------------------- IMAGE -------------------
+
+// region ------------------- RECIPE -------------------
+
+#define RECIPE_VALUES 256
+#define RECIPE_NAME 64
+#define RECIPE_LINE 512
+
+#define RECIPE_INT 0
+#define RECIPE_FLOAT 1
+#define RECIPE_VEC2 2
+#define RECIPE_VEC3 3
+#define RECIPE_VEC4 4
+#define RECIPE_MAT4 5
+
+// host only: the labels of a ShaderEd recipe evaluated on the CPU, vectors are kept in v
+typedef struct RecipeValue {
+    char name[RECIPE_NAME];
+    int type;
+    int i;
+    float f;
+    vec4 v;
+    mat4 m;
+} RecipeValue;
+
+typedef struct Recipe {
+    int count;
+    int errorLine;              // the line the parsing stopped at, 0 when it went through
+    RecipeValue values[RECIPE_VALUES];
+} Recipe;
+
+bool recipeParse(Recipe *recipe, const char *text);
+bool recipeLoad(Recipe *recipe, const char *path);
+const RecipeValue *recipeFind(const Recipe *recipe, const char *name);
+bool recipeGetFloat(const Recipe *recipe, const char *name, float *result);
+bool recipeGetInt(const Recipe *recipe, const char *name, int *result);
+bool recipeGetVec(const Recipe *recipe, const char *name, int type, vec4 *result);
+bool recipeGetMat4(const Recipe *recipe, const char *name, mat4 *result);
+
+// endregion ------------------- RECIPE -------------------
+
+// region ------------------- SDF CACHE -------------------
+
+// host only: sceneDist baked into a grid of resX * resY * resZ samples, cell apart
+typedef struct SdfCache {
+    vec3 min;
+    float cell;
+    int resX;
+    int resY;
+    int resZ;
+    long key; // the program the grid was baked from
+    float *dist;
+} SdfCache;
+
+long sdfCacheKey();
+bool sdfCacheBake(SdfCache *cache, vec3 min, vec3 max, float cell, int threadsCnt);
+void sdfCacheFree(SdfCache *cache);
+bool sdfCacheSave(const SdfCache *cache, const char *path);
+bool sdfCacheLoad(SdfCache *cache, const char *path);
+float sdfCacheDist(const SdfCache *cache, vec3 p);
+float rayMarchCache(const SdfCache *cache, vec3 ro, vec3 rd);
+
+// endregion ------------------- SDF CACHE -------------------
+
+// region ------------------- RAYTRACER -------------------
+
+typedef struct RtParams {
+    int width;
+    int height;
+    int samples;
+    int bounces;
+    vec3 eye;
+    vec3 center;
+    vec3 up;
+    float fovy;
+    float aspect;
+    float aperture;
+    float focusDist;
+    float random;
+    bool wavefront;
+} RtParams;
+
+typedef struct RtAccum {
+    vec3 sum;
+    int samples;
+    float mean;
+    float m2;
+    int passes;
+    bool converged;
+} RtAccum;
+
+typedef void (*RtPassFunc)(int pass, const vec4 *estimate, int active, void *context);
+
+HitRecord rayHitSphere(ray ray, float tMin, float tMax, Sphere sphere);
+HitRecord rayHitBvh(ray ray, float tMin, float tMax, int index);
+bool raytracerRender(const RtParams *params, vec4 *pixels, const ImageStream *stream, int threadsCnt);
+int raytracerProgressive(const RtParams *params, int passesMax, float threshold,
+                         vec4 *estimate, RtPassFunc callback, void *context, int threadsCnt);
+void raytracer(bool wavefront);
+void raytracerPreview();
+
+// endregion ------------------- RAYTRACER -------------------
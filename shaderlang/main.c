@@ -1,8 +1,10 @@
 #include "lang.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <float.h>
+#include <string.h>
 
 custom
 float error() {
@@ -15,7 +17,361 @@ void printv3(const vec3 v) {
 
 // region ------------------- MAIN ---------------
 
-int main() {
+void testBvh() {
+    static BvhNode nodesBackup[MAX_BVH];
+    static Sphere spheresBackup[MAX_SPHERES];
+    memcpy(nodesBackup, uBvhNodes, sizeof(nodesBackup));
+    memcpy(spheresBackup, uSpheres, sizeof(spheresBackup));
+
+    Sphere spheres[MAX_SPHERES];
+    bvhRandomSpheres(spheres, MAX_SPHERES, 100.0f, 1.0f);
+    assert(bvhUpload(spheres, MAX_SPHERES));
+    assert(!bvhUpload(spheres, MAX_SPHERES + 1));
+    assert(bvhDepth(uBvhNodes, 0) <= BVH_STACK);
+    assert(bvhUploadWide() < MAX_SPHERES);
+    for (int i = 0; i < 256; i++) {
+        const vec3 target = mulv3f(subv3f(v3(rndf(itof(i)), rndf(itof(i) + 0.5f), 0.0f), 0.5f), 100.0f);
+        const ray r = { v3(0.0f, 0.0f, 150.0f), normv3(subv3(target, v3(0.0f, 0.0f, 150.0f))) };
+        HitRecord expected = NO_HIT;
+        for (int j = 0; j < MAX_SPHERES; j++) {
+            const HitRecord hit = rayHitSphere(r, BOUNCE_ERR, expected.t > 0 ? expected.t : FLT_MAX, spheres[j]);
+            if (hit.t > 0) {
+                expected = hit;
+            }
+        }
+        const HitRecord actual = rayHitBvh(r, BOUNCE_ERR, FLT_MAX, 0);
+        assert(actual.t == expected.t);
+        const HitRecord wide = rayHitBvhWide(bvhWideNodes, r, BOUNCE_ERR, FLT_MAX);
+        assert(wide.t == expected.t && eqv3(wide.normal, expected.normal));
+    }
+
+    memcpy(uBvhNodes, nodesBackup, sizeof(nodesBackup));
+    memcpy(uSpheres, spheresBackup, sizeof(spheresBackup));
+}
+
+void testSdf() {
+    // transforms aside: two spheres around the origin and every operator on them
+    uSdfPrims[0] = sdfPrimCreate(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), m4ident());
+    uSdfPrims[1] = sdfPrimCreate(SDF_SPHERE, v4(2.0f, 0.0f, 0.0f, 0.0f), m4ident());
+    const float small = sdfPrimDist(v3zero(), uSdfPrims[0]);
+    const float large = sdfPrimDist(v3zero(), uSdfPrims[1]);
+    uSdfOps[0] = sdfOpCreate(SDF_OP_PRIM, 0);
+    uSdfOps[1] = sdfOpCreate(SDF_OP_PRIM, 1);
+    uSdfOpsCnt = 2;
+    const int ops[] = { SDF_OP_UNION, SDF_OP_SUBTRACTION, SDF_OP_INTERSECTION };
+    const float expected[] = {
+            opUnion(small, large), opSubtraction(small, large), opIntersection(small, large) };
+    for (int i = 0; i < 3; i++) {
+        uSdfOps[2] = sdfOpCreate(ops[i], 0);
+        uSdfOpsCnt = 3;
+        assert(sceneDist(v3zero()) == expected[i]);
+        assert(sceneDistGrad(v3zero()).w == expected[i]);
+    }
+
+    // (0 - 1) u 2: links, polarity and the bounds standing in for a culled subtree
+    uSdfOps[2] = sdfOpCreate(SDF_OP_SUBTRACTION, 0);
+    uSdfOps[3] = sdfOpCreate(SDF_OP_PRIM, 0);
+    uSdfOps[4] = sdfOpCreate(SDF_OP_UNION, 0);
+    uSdfOpsCnt = 5;
+    sdfPrepare();
+    assert(uSdfOps[0].outer == 4 && uSdfOps[4].inner == 2 && uSdfOps[2].inner == 0 && uSdfOps[0].inner == -1);
+    assert(uSdfOps[1].outer == 1 && uSdfOps[3].outer == 3);
+    assert(uSdfOps[0].polarity == -1 && uSdfOps[1].polarity == 1 && uSdfOps[3].polarity == 1);
+    assert(uSdfOps[2].bounds.w == 2.0f && uSdfOps[4].bounds.w == 2.0f);
+    assert(sceneDist(v3zero()) == opUnion(opSubtraction(small, large), small));
+    uSdfOps[2].bounds = v4(100.0f, 0.0f, 0.0f, 2.0f);
+    assert(sceneDist(v3zero()) == opUnion(98.0f, small));
+    uSdfOps[0].polarity = 1;
+    uSdfOps[1].bounds = v4(0.0f, 100.0f, 0.0f, 2.0f);
+    uSdfOps[2].bounds = uSdfOps[4].bounds;
+    uSdfOps[0].bounds = v4(0.0f, 0.0f, 100.0f, 1.0f);
+    assert(sceneDist(v3zero()) == opUnion(opSubtraction(99.0f, 98.0f), small));
+    uSdfOpsCnt = 0;
+
+    assert(marchEpsilon(0.0f, 0.001f) == MIN_DIST && marchEpsilon(1000.0f, 0.001f) == 1.0f);
+
+    // a subtracted sphere far away is replaced with the upper bound of its distance
+    uSdfPrims[0] = sdfPrimPlaced(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), translatem4(v3(20.0f, 0.0f, 0.0f)));
+    uSdfPrims[1] = sdfPrimCreate(SDF_SPHERE, v4(50.0f, 0.0f, 0.0f, 0.0f), m4ident());
+    uSdfOps[2] = sdfOpCreate(SDF_OP_SUBTRACTION, 0);
+    uSdfOpsCnt = 3;
+    sdfPrepare();
+    assert(eqv4(uSdfOps[0].bounds, v4(20.0f, 0.0f, 0.0f, 1.0f)));
+    assert(sdfPrimDist(v3(20.0f, 3.0f, 0.0f), uSdfPrims[0]) == 2.0f);
+    assert(sceneDist(v3zero()) == opSubtraction(21.0f, sdfPrimDist(v3zero(), uSdfPrims[1])));
+    assert(sceneDist(v3(19.0f, 0.0f, 0.0f)) == opSubtraction(0.0f, -31.0f));
+
+    // one sphere of radius 1: normals, gradients and both march modes agree on the hit
+    uSdfOps[0] = sdfOpCreate(SDF_OP_PRIM, 1);
+    uSdfPrims[1] = sdfPrimCreate(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), m4ident());
+    uSdfOpsCnt = 1;
+    sdfPrepare();
+    const vec4 grad = sceneDistGrad(v3(0.0f, 3.0f, 0.0f));
+    assert(eqv4(grad, v4(0.0f, 1.0f, 0.0f, 2.0f)));
+    assert(dotv3(getNormal(v3(0.0f, 0.0f, 1.0f)), v3(0.0f, 0.0f, 1.0f)) > 0.999f);
+    const MarchResult plain = rayMarchMode(v3(0.0f, 0.0f, 5.0f), v3(0.0f, 0.0f, -1.0f), MARCH_PLAIN, 0.0f);
+    const MarchResult relaxed = rayMarchMode(v3(0.0f, 0.0f, 5.0f), v3(0.0f, 0.0f, -1.0f), MARCH_RELAXED, 0.0f);
+    assert(absf(plain.t - 4.0f) < MIN_DIST && absf(relaxed.t - 4.0f) < MIN_DIST);
+    assert(shadowSoft(v3(0.0f, 0.0f, 5.0f), v3(0.0f, 0.0f, -1.0f), 10.0f) == 0.0f);
+    assert(shadowSoft(v3(0.0f, 0.0f, 5.0f), v3(0.0f, 0.0f, 1.0f), 10.0f) == 1.0f);
+
+    // grazing a plane, where the relaxed steps pay off
+    uSdfPrims[1] = sdfPrimCreate(SDF_PLANE, v4zero(), m4ident());
+    sdfPrepare();
+    const vec3 grazing = normv3(v3(1.0f, -0.05f, 0.0f));
+    const MarchResult plainPlane = rayMarchMode(v3(0.0f, 1.0f, 0.0f), grazing, MARCH_PLAIN, 0.0f);
+    const MarchResult relaxedPlane = rayMarchMode(v3(0.0f, 1.0f, 0.0f), grazing, MARCH_RELAXED, 0.0f);
+    assert(absf(sceneDist(addv3(v3(0.0f, 1.0f, 0.0f), mulv3f(grazing, plainPlane.t)))) < MIN_DIST);
+    assert(absf(sceneDist(addv3(v3(0.0f, 1.0f, 0.0f), mulv3f(grazing, relaxedPlane.t)))) < MIN_DIST);
+    assert(relaxedPlane.steps < plainPlane.steps);
+    uSdfOpsCnt = 0;
+}
+
+void testSdfLibrary() {
+    const vec3 p = v3(3.0f, 0.0f, 0.0f);
+    assert(sdTorus(p, v2(2.0f, 0.5f)) == 0.5f);
+    assert(sdCapsule(p, v3(0.0f, -1.0f, 0.0f), v3(0.0f, 1.0f, 0.0f), 1.0f) == 2.0f);
+    assert(sdRoundBox(p, v3(2.0f, 2.0f, 2.0f), 0.5f) == 1.0f);
+    assert(sdEllipsoid(p, v3(2.0f, 1.0f, 1.0f)) == 0.5f);
+    assert(opSmoothUnion(1.0f, 5.0f, 1.0f) == 1.0f && opSmoothUnion(1.0f, 1.0f, 1.0f) == 0.75f);
+    assert(opSmoothSubtraction(-1.0f, 1.0f, 1.0f) == 1.25f && opSmoothIntersection(1.0f, 1.0f, 1.0f) == 1.25f);
+    assert(eqv3(opRep(v3(9.0f, 9.0f, 9.0f), v3(4.0f, 0.0f, 0.0f)), v3(1.0f, 9.0f, 9.0f)));
+    assert(eqv3(opRepLim(v3(17.0f, 0.0f, 0.0f), v3(4.0f, 4.0f, 4.0f), v3(2.0f, 2.0f, 2.0f)), v3(9.0f, 0.0f, 0.0f)));
+    assert(opDisplace(v3zero(), 1.0f, v2(0.5f, 2.0f)) == 1.0f);
+
+    // a row of five spheres in one primitive: bounds, box and the distance to the last one
+    const SdfPrim sphere = sdfPrimCreate(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), m4ident());
+    const SdfPrim row = sdfPrimRepeat(sphere, v3(4.0f, 0.0f, 0.0f), v3(2.0f, 0.0f, 0.0f));
+    assert(sdfPrimDist(v3(8.0f, 0.0f, 0.0f), row) == -1.0f && sdfPrimDist(v3(13.0f, 0.0f, 0.0f), row) == 4.0f);
+    assert(eqv4(sdfPrimBounds(row), v4(0.0f, 0.0f, 0.0f, 9.0f)));
+    assert(eqv3(sdfPrimExtent(row), v3(9.0f, 1.0f, 1.0f)));
+    const SdfPrim endless = sdfPrimRepeat(sphere, v3(4.0f, 0.0f, 0.0f), v3zero());
+    assert(sdfPrimDist(v3(400.0f, 0.0f, 2.0f), endless) == 1.0f && sdfPrimBounds(endless).w == FLT_MAX);
+
+    // the Lipschitz bound keeps the scaled and the displaced fields below the distance
+    const SdfPrim scaled = sdfPrimPlaced(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), scalem4(v3(2.0f, 2.0f, 2.0f)));
+    assert(scaled.lipschitz == 0.5f && sdfPrimDist(v3(5.0f, 0.0f, 0.0f), scaled) == 3.0f);
+    const SdfPrim bumpy = sdfPrimDisplace(sphere, 0.1f, 4.0f);
+    assert(absf(bumpy.lipschitz - (1.0f + 0.4f * sqrtf(3.0f))) < 1e-6f);
+    assert(eqv4(sdfPrimBounds(bumpy), v4(0.0f, 0.0f, 0.0f, 1.1f)));
+    const SdfPrim box = sdfPrimPlaced(SDF_BOX, v4(1.0f, 2.0f, 3.0f, 0.0f), translatem4(v3(10.0f, 0.0f, 0.0f)));
+    const aabb bounds = sdfPrimBox(box);
+    assert(eqv3(bounds.pointMin, v3(9.0f, -2.0f, -3.0f)) && eqv3(bounds.pointMax, v3(11.0f, 2.0f, 3.0f)));
+
+    // two spheres blended: the culling spheres grow by the radius and the gradient follows the blend
+    uSdfPrims[0] = sdfPrimPlaced(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), translatem4(v3(-1.5f, 0.0f, 0.0f)));
+    uSdfPrims[1] = sdfPrimPlaced(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), translatem4(v3(1.5f, 0.0f, 0.0f)));
+    uSdfOps[0] = sdfOpCreate(SDF_OP_PRIM, 0);
+    uSdfOps[1] = sdfOpCreate(SDF_OP_PRIM, 1);
+    uSdfOps[2] = sdfOpSmooth(SDF_OP_SMOOTH_UNION, 2.0f);
+    uSdfOpsCnt = 3;
+    sdfPrepare();
+    assert(uSdfOps[0].bounds.w == 3.0f && uSdfOps[2].bounds.w == 3.0f);
+    const vec3 waist = v3(0.0f, 0.8f, 0.0f);
+    assert(sceneDist(waist) == opSmoothUnion(sdfPrimDist(waist, uSdfPrims[0]), sdfPrimDist(waist, uSdfPrims[1]), 2.0f));
+    assert(sceneDistGrad(waist).w == sceneDist(waist));
+    assert(dotv3(normv3(v4tov3(sceneDistGrad(waist))), getNormal(waist)) > 0.999f);
+    uSdfOpsCnt = 0;
+}
+
+void testSandGrid() {
+    // the packed cells: every field survives, a resting grain without a seed is its type
+    for (int dir = 0; dir < 9; dir++) {
+        const ivec2 move = iv2(dir % 3 - 1, dir / 3 - 1);
+        const int cell = sandPack(TYPE_WATER, move, 3);
+        assert(cell >= 0 && cell < 256);
+        assert(sandType(cell) == TYPE_WATER && eqiv2(sandMove(cell), move) && sandSeed(cell) == 3);
+    }
+    assert(sandPack(TYPE_SAND, iv2zero(), 0) == TYPE_SAND && sandPack(TYPE_EMPTY, iv2zero(), 0) == 0);
+
+    // a grain falls two rows and stays, the solver moves it into the free cell below
+    SandGrid grid;
+    assert(sandGridCreate(&grid, 3, 3));
+    grid.cells[2 * 3 + 1] = (unsigned char) TYPE_SAND;
+    sandGridPhysics(&grid, 1);
+    assert(eqiv2(sandMove(grid.deltas[2 * 3 + 1]), iv2(0, -1)));
+    sandGridSolve(&grid, 1);
+    assert(grid.next[1 * 3 + 1] == sandPack(TYPE_SAND, iv2(0, -1), 0) && grid.next[2 * 3 + 1] == TYPE_EMPTY);
+    sandGridStep(&grid, 2);
+    sandGridStep(&grid, 2);
+    sandGridStep(&grid, 2);
+    for (int i = 0; i < 9; i++) {
+        assert(grid.cells[i] == (i == 1 ? TYPE_SAND : TYPE_EMPTY));
+    }
+
+    // water on top of sand flows aside
+    memset(grid.cells, TYPE_SAND, 3);
+    grid.cells[1 * 3 + 1] = (unsigned char) TYPE_WATER;
+    sandGridWake(&grid);
+    sandGridStep(&grid, 1);
+    assert(grid.cells[1 * 3 + 1] == TYPE_EMPTY);
+    assert(sandType(grid.cells[1 * 3 + 0]) == TYPE_WATER || sandType(grid.cells[1 * 3 + 2]) == TYPE_WATER);
+
+    vec4 pixels[9];
+    sandGridDraw(&grid, pixels, 1);
+    assert(pixels[4].w == 1.0f);
+    sandGridFree(&grid);
+
+    // the blocks: a grain falls through both offsets, a crowded box keeps every particle
+    assert(sandGridCreate(&grid, 4, 4));
+    grid.mode = SAND_STEP_MARGOLUS;
+    grid.cells[3 * 4 + 1] = (unsigned char) TYPE_SAND;
+    sandGridWake(&grid);
+    for (int i = 0; i < 4; i++) {
+        sandGridStep(&grid, 1);
+    }
+    assert(grid.cells[1] == TYPE_SAND && grid.frame == 4);
+    sandGridFree(&grid);
+    assert(sandGridCreate(&grid, 32, 32));
+    grid.mode = SAND_STEP_MARGOLUS;
+    sandGridScatter(&grid, 0.9f);
+    int counts[3] = { 0, 0, 0 };
+    for (int i = 0; i < 32 * 32; i++) {
+        counts[sandType(grid.cells[i])]++;
+    }
+    for (int i = 0; i < 64; i++) {
+        sandGridStep(&grid, 2);
+    }
+    int settled[3] = { 0, 0, 0 };
+    for (int i = 0; i < 32 * 32; i++) {
+        settled[sandType(grid.cells[i])]++;
+    }
+    assert(settled[TYPE_SAND] == counts[TYPE_SAND] && settled[TYPE_WATER] == counts[TYPE_WATER]);
+    assert(grid.cells[0] != TYPE_EMPTY);
+    sandGridFree(&grid);
+
+    // sleeping chunks: the sparse steps match the steps over every chunk, a settled box goes to sleep
+    for (int mode = SAND_STEP_SOLVER; mode <= SAND_STEP_MARGOLUS; mode++) {
+        SandGrid dense;
+        assert(sandGridCreate(&grid, 80, 48) && sandGridCreate(&dense, 80, 48));
+        grid.mode = mode;
+        dense.mode = mode;
+        sandGridScatter(&grid, 0.5f);
+        sandGridScatter(&dense, 0.5f);
+        for (int i = 0; i < 96; i++) {
+            sandGridStep(&grid, 2);
+            sandGridWake(&dense);
+            sandGridStep(&dense, 2);
+            assert(memcmp(grid.cells, dense.cells, 80 * 48) == 0);
+        }
+        assert(grid.activeCnt < dense.activeCnt);
+
+        // water may wander forever, sand alone comes to rest
+        for (int i = 0; i < 80 * 48; i++) {
+            grid.cells[i] = grid.cells[i] == TYPE_EMPTY ? TYPE_EMPTY : TYPE_SAND;
+        }
+        sandGridWake(&grid);
+        do {
+            sandGridStep(&grid, 2);
+        } while (grid.activeCnt > 0 && grid.frame < 1000);
+        assert(grid.activeCnt == 0);
+        grid.cells[47 * 80 + 40] = (unsigned char) TYPE_SAND;
+        grid.changes[(47 / SAND_CHUNK) * grid.chunksX + 40 / SAND_CHUNK] = 1;
+        sandGridStep(&grid, 2);
+        assert(grid.activeCnt == 6);
+        sandGridFree(&grid);
+        sandGridFree(&dense);
+    }
+
+    // the choices hash the cell, the frame and the material: the same on any thread count and in a replay,
+    // the seeded generator does not leak in and a cell does not keep to one side
+    int lefts = 0;
+    for (int frame = 0; frame < 64; frame++) {
+        lefts += sandRnd(iv2(7, 3), frame, TYPE_SAND) > 0.5f ? 1 : 0;
+    }
+    assert(lefts > 16 && lefts < 48);
+    assert(sandRnd(iv2(7, 3), 5, TYPE_SAND) != sandRnd(iv2(7, 3), 5, TYPE_WATER));
+    for (int mode = SAND_STEP_SOLVER; mode <= SAND_STEP_MARGOLUS; mode++) {
+        SandGrid replay;
+        assert(sandGridCreate(&grid, 64, 64) && sandGridCreate(&replay, 64, 64));
+        grid.mode = mode;
+        replay.mode = mode;
+        sandGridScatter(&grid, 0.5f);
+        sandGridScatter(&replay, 0.5f);
+        for (int i = 0; i < 32; i++) {
+            sandGridStep(&grid, 1);
+            seedRandom(v3(itof(i), 1.0f, 2.0f));
+            sandGridStep(&replay, 4);
+        }
+        assert(memcmp(grid.cells, replay.cells, 64 * 64) == 0);
+        sandGridFree(&grid);
+        sandGridFree(&replay);
+    }
+}
+
+void testMat4() {
+    const mat4 placement = mulm4(translatem4(v3(1.0f, 2.0f, 3.0f)), rotatem4(v3(0.0f, 1.0f, 0.0f), PI / 2.0f));
+    const vec3 placed = affinev3(v3(1.0f, 0.0f, 0.0f), placement);
+    assert(absf(placed.x - 1.0f) < 1e-4f && placed.y == 2.0f && absf(placed.z - 4.0f) < 1e-4f);
+    assert(eqv3(v4tov3(transformv4(v3tov4(placed, 1.0f), m4ident())), placed));
+    assert(eqv3(placed, v4tov3(transformv4(v4(1.0f, 0.0f, 0.0f, 1.0f), placement))));
+    const vec3 back = affinev3(placed, inversem4Affine(placement));
+    assert(lenv3(subv3(back, v3(1.0f, 0.0f, 0.0f))) < 1e-5f);
+    const mat4 scaled = inversem4Affine(scalem4(v3(2.0f, 4.0f, 8.0f)));
+    assert(scaled.value[0] == 0.5f && scaled.value[5] == 0.25f && scaled.value[10] == 0.125f);
+}
+
+void testSdfCache() {
+    uSdfPrims[0] = sdfPrimCreate(SDF_SPHERE, v4(1.0f, 0.0f, 0.0f, 0.0f), m4ident());
+    uSdfPrims[1] = sdfPrimCreate(SDF_BOX, v4(1.0f, 2.0f, 0.5f, 0.0f), m4ident());
+    uSdfOps[0] = sdfOpCreate(SDF_OP_PRIM, 0);
+    uSdfOps[1] = sdfOpCreate(SDF_OP_PRIM, 1);
+    uSdfOps[2] = sdfOpCreate(SDF_OP_UNION, 0);
+    uSdfOpsCnt = 3;
+    sdfPrepare();
+
+    SdfCache cache;
+    assert(sdfCacheBake(&cache, v3(-4.0f, -4.0f, -4.0f), v3(4.0f, 4.0f, 4.0f), 0.5f, parallelThreads()));
+    assert(cache.resX == 17 && cache.resY == 17 && cache.resZ == 17);
+    const vec3 node = v3(-1.5f, 2.0f, 0.5f);
+    assert(sdfCacheDist(&cache, node) == sceneDist(node));
+    assert(sdfCacheDist(&cache, v3(10.0f, 0.0f, 0.0f)) == sceneDist(v3(10.0f, 0.0f, 0.0f)));
+    const vec3 eye = v3(0.0f, 0.0f, 3.9f);
+    assert(absf(rayMarchCache(&cache, eye, v3(0.0f, 0.0f, -1.0f)) - rayMarch(eye, v3(0.0f, 0.0f, -1.0f))) < MIN_DIST);
+
+    // a file is only picked up by the program it was baked from
+    const char *path = "sdfcache.bin";
+    assert(sdfCacheSave(&cache, path));
+    SdfCache loaded;
+    assert(sdfCacheLoad(&loaded, path));
+    assert(loaded.key == cache.key && loaded.resZ == cache.resZ);
+    assert(memcmp(loaded.dist, cache.dist, sizeof(float) * cache.resX * cache.resY * cache.resZ) == 0);
+    sdfCacheFree(&loaded);
+    uSdfOps[2] = sdfOpCreate(SDF_OP_INTERSECTION, 0);
+    assert(!sdfCacheLoad(&loaded, path));
+    remove(path);
+    sdfCacheFree(&cache);
+    uSdfOpsCnt = 0;
+}
+
+void testRecipe() {
+    static Recipe recipe;
+    const char *text =
+            "// comment\n"
+            "samplesAA:  2\n"
+            "\n"
+            "pi:         3.1415\n"
+            "piHalf:     divf pi 2f\n"
+            "shape:      v2 8 -1f\n"
+            "mat:        mulm4 (translatem4 (v3 1 2 3)) (m4ident)\n"
+            "shift:      translatem4 (v3 0 (subf 0 piHalf) 0.5)\n"
+            "samplesAA:  4\n";
+    assert(recipeParse(&recipe, text) && recipe.errorLine == 0);
+    int samplesAA;
+    float piHalf;
+    vec4 shape;
+    mat4 shift;
+    assert(recipeGetInt(&recipe, "samplesAA", &samplesAA) && samplesAA == 4);
+    assert(recipeGetFloat(&recipe, "piHalf", &piHalf) && piHalf == 3.1415f / 2.0f);
+    assert(recipeGetVec(&recipe, "shape", RECIPE_VEC2, &shape) && shape.x == 8.0f && shape.y == -1.0f);
+    assert(recipeGetMat4(&recipe, "shift", &shift) && shift.value[13] == -piHalf && shift.value[14] == 0.5f);
+    assert(recipeFind(&recipe, "mat") != NULL && recipeFind(&recipe, "missing") == NULL);
+    assert(!recipeGetFloat(&recipe, "shape", &piHalf));
+    assert(!recipeParse(&recipe, "broken: v3 1 2\n") && recipe.errorLine == 1);
+    assert(!recipeParse(&recipe, "// fine\nunknown: noop 1\n") && recipe.errorLine == 2);
+}
+
+int main(int argc, char **argv) {
     assert(eqv3(v3(1, 1, 1), v3(1, 1, 1)));
     assert(!eqv3(v3(1, 1, 1), v3(1, 0, 1)));
     assert(eqv3(negv3(ftov3(1)), ftov3(-1)));
@@ -36,6 +392,7 @@ int main() {
     assert(eqv4(mulv4f(v4(1, 1, 1, 1), 2.5f), v4(2.5f, 2.5f, 2.5f, 2.5f)));
     assert(eqv4(divv4(ftov4(4.0f), ftov4(2.0f)), ftov4(2.0f)));
     assert(eqv4(divv4f(v4(10, 10, 10, 10), 5.0f), v4(2.0f, 2.0f, 2.0f, 2.0f)));
+    assert(eqv4(divv4f(v4(2, 4, 6, 8), 2.0f), v4(1.0f, 2.0f, 3.0f, 4.0f)));
     assert(itof(123) == 123.0f);
     assert(ftoi(123.5f) == 123);
     assert(eqv2(tile(v2(1.0f, 1.0f), iv2(1, 1), iv2(2, 2)), ftov2(1.0f)));
@@ -46,7 +403,31 @@ int main() {
     assert(lenv3(normv3(v3(10, 10, 10))) - 1.0f < FLT_EPSILON);
     assert(eqv3(lerpv3(v3zero(), v3one(), 0.5f), ftov3(0.5f)));
     assert(eqv3(rayPoint(rayBack(), 10.0f), v3(0, 0, -10)));
-    raytracer();
+    assert(rndf(1.0f) == 0.5736618041992188f);
+    assert(rndv2(v2(0.5f, 0.25f)) == 0.08993911743164062f);
+    seedRandom(v3(0.5f, 0.25f, 1.0f));
+    const float rnd0 = seededRndf();
+    const float rnd1 = seededRndf();
+    seedRandom(v3(0.5f, 0.25f, 1.0f));
+    assert(seededRndf() == rnd0 && seededRndf() == rnd1 && rnd0 != rnd1);
+    assert(rnd0 >= 0.0f && rnd0 < 1.0f);
+    testBvh();
+    testMat4();
+    testSdf();
+    testSdfLibrary();
+    testSdfCache();
+    testRecipe();
+    testSandGrid();
+    if (argc > 2 && strcmp(argv[1], "--raymarcher") == 0) {
+        raymarcherRecipe(argv[2], argc > 3 && strcmp(argv[3], "--adaptive") == 0);
+    } else if (argc > 4 && strcmp(argv[1], "--sandsim") == 0) {
+        const bool margolus = argc > 5 && strcmp(argv[5], "--margolus") == 0;
+        sandGridRun(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), margolus ? SAND_STEP_MARGOLUS : SAND_STEP_SOLVER);
+    } else if (argc > 1 && strcmp(argv[1], "--progressive") == 0) {
+        raytracerPreview();
+    } else {
+        raytracer(argc > 1 && strcmp(argv[1], "--wavefront") == 0);
+    }
     return 0;
 }
 
@@ -3,9 +3,12 @@
 //
 
 #include "lang.h"
+#include "simd.h"
 
 // region ------------------- MAT4 -------------------
 
+// column-major as in GLSL: value[column * 4 + row]
+
 custom
 mat4 m4ident() {
     const mat4 result = {{
@@ -19,21 +22,63 @@ mat4 m4ident() {
 
 custom
 mat4 mulm4(const mat4 left, const mat4 right) {
-    return m4ident();
+    mat4 result;
+    for (int i = 0; i < 4; i++) {
+        const float *column = &right.value[i * 4];
+        simdTransform(left.value, column[0], column[1], column[2], column[3], &result.value[i * 4]);
+    }
+    return result;
 }
 
 custom
 vec4 transformv4(const vec4 vec, const mat4 mat) {
-    return v4zero();
+    vec4 result;
+    simdTransform(mat.value, vec.x, vec.y, vec.z, vec.w, &result.x);
+    return result;
+}
+
+// transformv4 of a point with the bottom row taken as (0, 0, 0, 1)
+custom
+vec3 affinev3(const vec3 vec, const mat4 mat) {
+    float result[4];
+    simdAffine(mat.value, vec.x, vec.y, vec.z, result);
+    return v3(result[0], result[1], result[2]);
+}
+
+// inverse of rotation, uniform or non uniform scale and translation, computed once and not per step
+custom
+mat4 inversem4Affine(const mat4 mat) {
+    const float *m = mat.value;
+    const float c00 = m[5] * m[10] - m[9] * m[6];
+    const float c01 = m[9] * m[2] - m[1] * m[10];
+    const float c02 = m[1] * m[6] - m[5] * m[2];
+    const float det = m[0] * c00 + m[4] * c01 + m[8] * c02;
+    const float inv = 1.0f / det;
+
+    mat4 result = m4ident();
+    float *r = result.value;
+    r[0] = c00 * inv;
+    r[1] = c01 * inv;
+    r[2] = c02 * inv;
+    r[4] = (m[8] * m[6] - m[4] * m[10]) * inv;
+    r[5] = (m[0] * m[10] - m[8] * m[2]) * inv;
+    r[6] = (m[4] * m[2] - m[0] * m[6]) * inv;
+    r[8] = (m[4] * m[9] - m[8] * m[5]) * inv;
+    r[9] = (m[8] * m[1] - m[0] * m[9]) * inv;
+    r[10] = (m[0] * m[5] - m[4] * m[1]) * inv;
+    r[12] = -(r[0] * m[12] + r[4] * m[13] + r[8] * m[14]);
+    r[13] = -(r[1] * m[12] + r[5] * m[13] + r[9] * m[14]);
+    r[14] = -(r[2] * m[12] + r[6] * m[13] + r[10] * m[14]);
+    return result;
 }
 
 custom
 mat4 translatem4(vec3 vec) {
     const mat4 result = {{
-        1, 0, 0, vec.x,
-        0, 1, 0, vec.y,
-        0, 0, 1, vec.z,
-        0, 0, 0, 1
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        vec.x, vec.y, vec.z, 1
     }};
     return result;
 }
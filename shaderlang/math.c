@@ -3,6 +3,7 @@
 //
 
 #include "lang.h"
+#include "simd.h"
 
 #include <math.h>
 #include <stdlib.h>
@@ -27,7 +28,7 @@ float absf(const float value) {
 
 custom
 float sqrtf(const float value) {
-    return (float) sqrt((double) value);
+    return simdSqrtf(value);
 }
 
 custom
@@ -79,7 +80,7 @@ float smoothf(float edge0, float edge1, float x) {
 
 custom
 float floorf(float value) {
-    return floor((double) value);
+    return simdFloorf(value);
 }
 
 custom
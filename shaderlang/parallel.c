@@ -0,0 +1,76 @@
+//
+// Created by greg on 2021-08-20.
+//
+
+#include "lang.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// region ------------------- PARALLEL ---------------
+
+typedef struct TileQueue {
+    int width;
+    int height;
+    int tileW;
+    int tileH;
+    int tilesX;
+    int tilesCnt;
+    atomic_int next;
+    TileFunc func;
+    void *context;
+} TileQueue;
+
+static void *parallelWorker(void *arg) {
+    TileQueue *queue = arg;
+    while (true) {
+        const int tile = atomic_fetch_add(&queue->next, 1);
+        if (tile >= queue->tilesCnt) {
+            break;
+        }
+        const int x0 = (tile % queue->tilesX) * queue->tileW;
+        const int y0 = (tile / queue->tilesX) * queue->tileH;
+        const int x1 = x0 + queue->tileW < queue->width ? x0 + queue->tileW : queue->width;
+        const int y1 = y0 + queue->tileH < queue->height ? y0 + queue->tileH : queue->height;
+        queue->func(x0, y0, x1, y1, queue->context);
+    }
+    return NULL;
+}
+
+int parallelThreads() {
+    const long cnt = sysconf(_SC_NPROCESSORS_ONLN);
+    return cnt > 0 ? (int) cnt : 1;
+}
+
+void parallelTiles(const int width, const int height, const int tileW, const int tileH,
+                   const int threadsCnt, const TileFunc func, void *context) {
+    TileQueue queue;
+    queue.width = width;
+    queue.height = height;
+    queue.tileW = tileW;
+    queue.tileH = tileH;
+    queue.tilesX = (width + tileW - 1) / tileW;
+    queue.tilesCnt = queue.tilesX * ((height + tileH - 1) / tileH);
+    atomic_init(&queue.next, 0);
+    queue.func = func;
+    queue.context = context;
+
+    // the calling thread is the last worker
+    const int spawnCnt = (threadsCnt < queue.tilesCnt ? threadsCnt : queue.tilesCnt) - 1;
+    pthread_t *threads = spawnCnt > 0 ? malloc(sizeof(pthread_t) * spawnCnt) : NULL;
+    int spawned = 0;
+    for (; spawned < spawnCnt; spawned++) {
+        if (pthread_create(&threads[spawned], NULL, parallelWorker, &queue) != 0) {
+            break; // fewer workers, same result
+        }
+    }
+    parallelWorker(&queue);
+    for (int i = 0; i < spawned; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+// endregion ------------------- PARALLEL ---------------
@@ -4,30 +4,81 @@
 
 #include "lang.h"
 
-#include <stdlib.h>
+#include <float.h>
+#include <string.h>
 
 // region ------------------- RAND -------------------
 
+// Mirrors CUSTOM_RANDOM_DEF in GlCustom.kt bit for bit, so CPU and GPU frames can be diffed:
+// a single iteration of Bob Jenkins' One-At-A-Time hashing over the float bits.
+static unsigned int hash(unsigned int x) {
+    x += (x << 10u);
+    x ^= (x >>  6u);
+    x += (x <<  3u);
+    x ^= (x >> 11u);
+    x += (x << 15u);
+    return x;
+}
+
+static unsigned int floatBits(const float f) {
+    unsigned int result;
+    memcpy(&result, &f, sizeof(result));
+    return result;
+}
+
+// Construct a float with half-open range [0:1] using low 23 bits.
+static float floatConstruct(unsigned int m) {
+    const unsigned int ieeeMantissa = 0x007FFFFFu;
+    const unsigned int ieeeOne      = 0x3F800000u;
+    m &= ieeeMantissa;
+    m |= ieeeOne;
+    float f;
+    memcpy(&f, &m, sizeof(f));
+    return f - 1.0f;
+}
+
 custom
-float rndf (float x) { return dtof(drand48()); }
+float rndf(const float x) {
+    return floatConstruct(hash(floatBits(x)));
+}
 
 custom
-float rndv2(vec2  v) { return dtof(drand48()); }
+float rndv2(const vec2 v) {
+    return floatConstruct(hash(floatBits(v.x) ^ hash(floatBits(v.y))));
+}
 
 custom
-float rndv3(vec3  v) { return dtof(drand48()); }
+float rndv3(const vec3 v) {
+    return floatConstruct(hash(floatBits(v.x) ^ hash(floatBits(v.y)) ^ hash(floatBits(v.z))));
+}
 
 custom
-float rndv4(vec4  v) { return dtof(drand48()); }
+float rndv4(const vec4 v) {
+    return floatConstruct(hash(floatBits(v.x) ^ hash(floatBits(v.y)) ^ hash(floatBits(v.z)) ^ hash(floatBits(v.w))));
+}
+
+// a fragment invocation starts with a fresh seed on the GPU - here seeding starts over per thread
+_Thread_local vec4 seed = { 0.0f, 0.0f, 0.0f, 0.0f };
 
 custom
 vec3 seedRandom(const vec3 s) {
+    seed = v3tov4(s, 0.0f);
     return s;
 }
 
 custom
 float seededRndf() {
-    return dtof(drand48());
+    seed.w += FLT_MIN;
+    return rndv4(seed);
+}
+
+// host only: lets interleaved paths carry their own sequence
+vec4 seedSave() {
+    return seed;
+}
+
+void seedRestore(const vec4 s) {
+    seed = s;
 }
 
 public
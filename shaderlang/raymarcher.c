@@ -4,6 +4,17 @@
 
 #include "lang.h"
 
+#include <float.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RM_TILE 16
+#define RM_EDGE_DEPTH 0.05f
+#define RM_EDGE_NORMAL 0.9f
+
 public
 const int MAX_STEPS = 100;
 
@@ -14,113 +25,640 @@ public
 const float MIN_DIST = 0.01f;
 
 public
-typedef struct RaymarcherScene {
-    float cylALen;      float cylARad;      mat4 cylAMat;
-    vec2 coneBShape;    float coneBHeight;  mat4 coneBMat;
-    float cylCLen;      float cylCRad;      mat4 cylCMat;
-    vec3 boxDShape;     mat4 boxDMat;
-    vec3 boxEShape;     mat4 boxEMat;
-    vec2 prismFShape;   mat4 prismFMat;
-    float cylGLen;      float cylGRad;      mat4 cylGMat;
-    vec3 boxHShape;     mat4 boxHMat;
-} RaymarcherScene;
+const float CULL_DIST = 0.5f;
+
+public
+const float MARCH_RELAXATION = 1.6f;
+
+public
+const float SHADOW_SOFTNESS = 8.0f;
 
+// How steep the world space field of the primitive can get: the shapes themselves are bounds with
+// a slope of one, the displacement adds its own, the transform stretches both by its largest singular
+// value - bounded by the rows of the Gram matrix of its columns, exact for rigid and uniform scale.
 protected
-float sceneDist(const vec3 p, const RaymarcherScene scene) {
-    const vec4 p4 = v3tov4(p, 1.0f);
+float sdfPrimLipschitz(const SdfPrim prim) {
+    const vec3 c0 = v4tov3(transformv4(v4(1.0f, 0.0f, 0.0f, 0.0f), prim.transform));
+    const vec3 c1 = v4tov3(transformv4(v4(0.0f, 1.0f, 0.0f, 0.0f), prim.transform));
+    const vec3 c2 = v4tov3(transformv4(v4(0.0f, 0.0f, 1.0f, 0.0f), prim.transform));
+    const float r0 = dotv3(c0, c0) + absf(dotv3(c0, c1)) + absf(dotv3(c0, c2));
+    const float r1 = absf(dotv3(c1, c0)) + dotv3(c1, c1) + absf(dotv3(c1, c2));
+    const float r2 = absf(dotv3(c2, c0)) + absf(dotv3(c2, c1)) + dotv3(c2, c2);
+    const float stretch = sqrtf(maxf(r0, maxf(r1, r2)));
+    const float slope = 1.0f + absf(prim.displace.x * prim.displace.y) * sqrtf(3.0f);
+    return slope * stretch;
+}
 
-    const vec3 cylAP = v4tov3(transformv4(p4, scene.cylAMat));
-    const float cylA = sdSimplifiedCyl(cylAP, scene.cylALen, scene.cylARad);
+protected
+SdfPrim sdfPrimCreate(const int type, const vec4 params, const mat4 transform) {
+    SdfPrim result = { type, params, transform, v4zero(), v4zero(), v2zero(), 1.0f };
+    result.lipschitz = sdfPrimLipschitz(result);
+    return result;
+}
 
-    const vec3 coneBP = v4tov3(transformv4(p4, scene.coneBMat));
-    const float coneB = sdCone(coneBP, scene.coneBShape, scene.coneBHeight);
+// placed with an object to world matrix, inverted here once instead of on every step
+protected
+SdfPrim sdfPrimPlaced(const int type, const vec4 params, const mat4 placement) {
+    return sdfPrimCreate(type, params, inversem4Affine(placement));
+}
 
-    const vec3 cylCP = v4tov3(transformv4(p4, scene.cylCMat));
-    const float cylC = sdSimplifiedCyl(cylCP, scene.cylCLen, scene.cylCRad);
+// copies of the primitive along the local axes, one evaluation however many copies
+protected
+SdfPrim sdfPrimRepeat(const SdfPrim prim, const vec3 period, const vec3 limit) {
+    SdfPrim result = prim;
+    result.repeat = v3tov4(period, 0.0f);
+    result.limit = v3tov4(limit, 0.0f);
+    result.lipschitz = sdfPrimLipschitz(result);
+    return result;
+}
 
-    const vec3 boxDP = v4tov3(transformv4(p4, scene.boxDMat));
-    const float boxD = sdBox(boxDP, scene.boxDShape);
+protected
+SdfPrim sdfPrimDisplace(const SdfPrim prim, const float amplitude, const float frequency) {
+    SdfPrim result = prim;
+    result.displace = v2(amplitude, frequency);
+    result.lipschitz = sdfPrimLipschitz(result);
+    return result;
+}
 
-    const vec3 boxEP = v4tov3(transformv4(p4, scene.boxEMat));
-    const float boxE = sdBox(boxEP, scene.boxEShape);
+protected
+SdfOp sdfOpCreate(const int op, const int index) {
+    const SdfOp result = { op, index, 0.0f, v4zero(), 1, -1, -1 };
+    return result;
+}
 
-    const vec3 prismFP = v4tov3(transformv4(p4, scene.prismFMat));
-    const float prismF = sdTriPrism(prismFP, scene.prismFShape);
+protected
+SdfOp sdfOpSmooth(const int op, const float blend) {
+    const SdfOp result = { op, 0, blend, v4zero(), 1, -1, -1 };
+    return result;
+}
 
-    const vec3 cylGP = v4tov3(transformv4(p4, scene.cylGMat));
-    const float cylG = sdSimplifiedCyl(cylGP, scene.cylGLen, scene.cylGRad);
+protected
+vec3 sdfPrimLocal(const vec3 p, const SdfPrim prim) {
+    const vec3 local = affinev3(p, prim.transform);
+    return opRepLim(local, v4tov3(prim.repeat), v4tov3(prim.limit));
+}
 
-    const vec3 boxHP = v4tov3(transformv4(p4, scene.boxHMat));
-    const float boxH = sdBox(boxHP, scene.boxHShape);
+// the shape alone, in the local units of the primitive
+protected
+float sdfPrimShape(const vec3 local, const SdfPrim prim) {
+    switch (prim.type) {
+        case SDF_SPHERE:
+            return sdSphere(local, prim.params.x);
+        case SDF_BOX:
+            return sdBox(local, v4tov3(prim.params));
+        case SDF_CYLINDER:
+            return sdSimplifiedCyl(local, prim.params.x, prim.params.y);
+        case SDF_CONE:
+            return sdCone(local, v2(prim.params.x, prim.params.y), prim.params.z);
+        case SDF_PRISM:
+            return sdTriPrism(local, v2(prim.params.x, prim.params.y));
+        case SDF_PLANE:
+            return sdXZPlane(local);
+        case SDF_TORUS:
+            return sdTorus(local, v2(prim.params.x, prim.params.y));
+        case SDF_CAPSULE:
+            return sdCapsule(local, v3(0.0f, -prim.params.x * 0.5f, 0.0f), v3(0.0f, prim.params.x * 0.5f, 0.0f),
+                             prim.params.y);
+        case SDF_ROUND_BOX:
+            return sdRoundBox(local, v4tov3(prim.params), prim.params.w);
+        case SDF_ELLIPSOID:
+            return sdEllipsoid(local, v4tov3(prim.params));
+        default:
+            return error();
+    }
+}
 
-    const float AB = opSubtraction(coneB, cylA);
-    const float AC = opUnion(AB, cylC);
-    const float AD = opUnion(AC, boxD);
-    const float AE = opUnion(AD, boxE);
-    const float AF = opUnion(AE, prismF);
-    const float AG = opUnion(AF, cylG);
-    const float AH = opSubtraction(boxH, AG);
+protected
+float sdfPrimDist(const vec3 p, const SdfPrim prim) {
+    const vec3 local = sdfPrimLocal(p, prim);
+    float dist = sdfPrimShape(local, prim);
+    if (prim.displace.x != 0.0f) {
+        dist = opDisplace(local, dist, prim.displace);
+    }
+    return dist / prim.lipschitz;
+}
 
-    return AH;
+// the gradient in world space and the distance in w; numeric for the primitives without a closed form
+protected
+vec4 sdfPrimGrad(const vec3 p, const SdfPrim prim) {
+    const vec3 local = sdfPrimLocal(p, prim);
+    vec3 grad;
+    float dist;
+    if (prim.type == SDF_SPHERE) {
+        const float len = lenv3(local);
+        grad = len > 0.0f ? divv3f(local, len) : v3up();
+        dist = len - prim.params.x;
+    } else if (prim.type == SDF_BOX) {
+        const vec3 w = subv3(absv3(local), v4tov3(prim.params));
+        const vec3 q = maxv3(w, v3zero());
+        const float inside = maxf(w.x, maxf(w.y, w.z));
+        const float len = lenv3(q);
+        if (inside > 0.0f) {
+            grad = divv3f(q, len);
+        } else if (w.x > w.y && w.x > w.z) {
+            grad = v3(1.0f, 0.0f, 0.0f);
+        } else if (w.y > w.z) {
+            grad = v3(0.0f, 1.0f, 0.0f);
+        } else {
+            grad = v3(0.0f, 0.0f, 1.0f);
+        }
+        grad = mulv3(grad, v3(signf(local.x), signf(local.y), signf(local.z)));
+        dist = len + minf(inside, 0.0f);
+    } else if (prim.type == SDF_PLANE) {
+        grad = v3up();
+        dist = local.y;
+    } else {
+        // tetrahedron taps around p - in world space already
+        const vec3 k0 = v3( 1.0f, -1.0f, -1.0f);
+        const vec3 k1 = v3(-1.0f, -1.0f,  1.0f);
+        const vec3 k2 = v3(-1.0f,  1.0f, -1.0f);
+        const vec3 k3 = v3( 1.0f,  1.0f,  1.0f);
+        const float d0 = sdfPrimDist(addv3(p, mulv3f(k0, MIN_DIST)), prim);
+        const float d1 = sdfPrimDist(addv3(p, mulv3f(k1, MIN_DIST)), prim);
+        const float d2 = sdfPrimDist(addv3(p, mulv3f(k2, MIN_DIST)), prim);
+        const float d3 = sdfPrimDist(addv3(p, mulv3f(k3, MIN_DIST)), prim);
+        const vec3 n = addv3(addv3(mulv3f(k0, d0), mulv3f(k1, d1)), addv3(mulv3f(k2, d2), mulv3f(k3, d3)));
+        return v3tov4(normv3(n), sdfPrimDist(p, prim));
+    }
+    if (prim.displace.x != 0.0f) {
+        const vec3 f = mulv3f(local, prim.displace.y);
+        const vec3 sines = v3(sinf(f.x), sinf(f.y), sinf(f.z));
+        const vec3 cosines = v3(cosf(f.x), cosf(f.y), cosf(f.z));
+        const vec3 slope = v3(cosines.x * sines.y * sines.z, sines.x * cosines.y * sines.z,
+                              sines.x * sines.y * cosines.z);
+        grad = addv3(grad, mulv3f(slope, prim.displace.x * prim.displace.y));
+        dist = opDisplace(local, dist, prim.displace);
+    }
+
+    // back to the world: transpose of the linear part, columns through transformv4
+    const vec3 axisX = v4tov3(transformv4(v4(1.0f, 0.0f, 0.0f, 0.0f), prim.transform));
+    const vec3 axisY = v4tov3(transformv4(v4(0.0f, 1.0f, 0.0f, 0.0f), prim.transform));
+    const vec3 axisZ = v4tov3(transformv4(v4(0.0f, 0.0f, 1.0f, 0.0f), prim.transform));
+    const vec3 world = v3(dotv3(axisX, grad), dotv3(axisY, grad), dotv3(axisZ, grad));
+    return v3tov4(divv3f(world, prim.lipschitz), dist / prim.lipschitz);
 }
 
+// half of the local bounding box around the local origin, FLT_MAX along the endless axes
 protected
-float rayMarch(const vec3 ro, const vec3 rd, const RaymarcherScene scene) {
+vec3 sdfPrimExtent(const SdfPrim prim) {
+    vec3 extent;
+    switch (prim.type) {
+        case SDF_SPHERE:
+            extent = ftov3(prim.params.x);
+            break;
+        case SDF_BOX:
+        case SDF_ROUND_BOX:
+        case SDF_ELLIPSOID:
+            extent = v4tov3(prim.params);
+            break;
+        case SDF_CYLINDER:
+            extent = v3(prim.params.y, prim.params.y, prim.params.x * 0.5f);
+            break;
+        case SDF_CONE:
+            extent = v3(prim.params.z * prim.params.x / prim.params.y, prim.params.z,
+                        prim.params.z * prim.params.x / prim.params.y);
+            break;
+        case SDF_PRISM:
+            extent = v3(prim.params.x * 0.866025f, prim.params.x, prim.params.y);
+            break;
+        case SDF_TORUS:
+            extent = v3(prim.params.x + prim.params.y, prim.params.y, prim.params.x + prim.params.y);
+            break;
+        case SDF_CAPSULE:
+            extent = v3(prim.params.y, prim.params.x * 0.5f + prim.params.y, prim.params.y);
+            break;
+        default:
+            return ftov3(FLT_MAX);
+    }
+    const vec3 period = absv3(v4tov3(prim.repeat));
+    if ((period.x > 0.0f && prim.limit.x <= 0.0f) || (period.y > 0.0f && prim.limit.y <= 0.0f)
+            || (period.z > 0.0f && prim.limit.z <= 0.0f)) {
+        return ftov3(FLT_MAX);
+    }
+    const vec3 copies = mulv3(period, v4tov3(prim.limit));
+    return addv3(addv3(extent, ftov3(absf(prim.displace.x))), copies);
+}
+
+// the local box carried into the world through the absolute linear part of the inverse
+protected
+aabb sdfPrimBox(const SdfPrim prim) {
+    const vec3 extent = sdfPrimExtent(prim);
+    if (maxf(extent.x, maxf(extent.y, extent.z)) == FLT_MAX) {
+        const aabb endless = { ftov3(-FLT_MAX), ftov3(FLT_MAX) };
+        return endless;
+    }
+    const mat4 inverse = inversem4Affine(prim.transform);
+    const vec3 center = affinev3(v3zero(), inverse);
+    const vec3 axisX = absv3(v4tov3(transformv4(v4(1.0f, 0.0f, 0.0f, 0.0f), inverse)));
+    const vec3 axisY = absv3(v4tov3(transformv4(v4(0.0f, 1.0f, 0.0f, 0.0f), inverse)));
+    const vec3 axisZ = absv3(v4tov3(transformv4(v4(0.0f, 0.0f, 1.0f, 0.0f), inverse)));
+    const vec3 halfExtent = addv3(addv3(mulv3f(axisX, extent.x), mulv3f(axisY, extent.y)),
+                                  mulv3f(axisZ, extent.z));
+    const aabb result = { subv3(center, halfExtent), addv3(center, halfExtent) };
+    return result;
+}
+
+// bounding sphere in world space, tighter than the one around the box for the round shapes
+protected
+vec4 sdfPrimBounds(const SdfPrim prim) {
+    const vec3 extent = sdfPrimExtent(prim);
+    if (maxf(extent.x, maxf(extent.y, extent.z)) == FLT_MAX) {
+        return v4(0.0f, 0.0f, 0.0f, FLT_MAX);
+    }
+    float radius;
+    switch (prim.type) {
+        case SDF_SPHERE:
+            radius = prim.params.x;
+            break;
+        case SDF_CYLINDER:
+            radius = lenv2(v2(prim.params.x * 0.5f, prim.params.y));
+            break;
+        case SDF_CONE:
+            radius = lenv2(v2(prim.params.z * prim.params.x / prim.params.y, prim.params.z));
+            break;
+        case SDF_PRISM:
+            radius = lenv2(v2(prim.params.x, prim.params.y));
+            break;
+        case SDF_TORUS:
+            radius = prim.params.x + prim.params.y;
+            break;
+        case SDF_CAPSULE:
+            radius = prim.params.x * 0.5f + prim.params.y;
+            break;
+        case SDF_ELLIPSOID:
+            radius = maxf(prim.params.x, maxf(prim.params.y, prim.params.z));
+            break;
+        default:
+            radius = lenv3(v4tov3(prim.params));
+            break;
+    }
+    radius += absf(prim.displace.x) + lenv3(mulv3(absv3(v4tov3(prim.repeat)), v4tov3(prim.limit)));
+
+    // the local origin and the longest local unit back in the world
+    const mat4 inverse = inversem4Affine(prim.transform);
+    const float scale = maxf(lenv3(v4tov3(transformv4(v4(1.0f, 0.0f, 0.0f, 0.0f), inverse))),
+                             maxf(lenv3(v4tov3(transformv4(v4(0.0f, 1.0f, 0.0f, 0.0f), inverse))),
+                                  lenv3(v4tov3(transformv4(v4(0.0f, 0.0f, 1.0f, 0.0f), inverse)))));
+    return v3tov4(affinev3(v3zero(), inverse), radius * scale);
+}
+
+protected
+vec4 sdfBoundsUnion(const vec4 left, const vec4 right) {
+    const vec3 between = subv3(v4tov3(right), v4tov3(left));
+    const float dist = lenv3(between);
+    if (dist + right.w <= left.w) {
+        return left;
+    }
+    if (dist + left.w <= right.w) {
+        return right;
+    }
+    const float radius = (dist + left.w + right.w) * 0.5f;
+    return v3tov4(addv3(v4tov3(left), mulv3f(between, (radius - left.w) / dist)), radius);
+}
+
+// Links every primitive to the subtrees starting with it, sceneDist culls them through the links.
+// Host only, like sdfLoadScene: the shaders get the program prepared and only read it.
+void sdfPrepare() {
+    vec4 bounds[SDF_STACK];
+    int begins[SDF_STACK];
+    int top = 0;
+    for (int i = 0; i < uSdfOpsCnt; i++) {
+        if (uSdfOps[i].op == SDF_OP_PRIM) {
+            bounds[top] = sdfPrimBounds(uSdfPrims[uSdfOps[i].index]);
+            begins[top] = i;
+            uSdfOps[i].outer = i;
+            uSdfOps[i].inner = -1;
+            top++;
+        } else {
+            top--;
+            const vec4 left = bounds[top - 1];
+            const vec4 right = bounds[top];
+            if (uSdfOps[i].op == SDF_OP_UNION) {
+                bounds[top - 1] = sdfBoundsUnion(left, right);
+            } else if (uSdfOps[i].op == SDF_OP_SMOOTH_UNION) {
+                const vec4 merged = sdfBoundsUnion(left, right);
+                bounds[top - 1] = setwv4(merged, merged.w + uSdfOps[i].blend * 0.25f);
+            } else if (uSdfOps[i].op == SDF_OP_SUBTRACTION || uSdfOps[i].op == SDF_OP_SMOOTH_SUBTRACTION) {
+                bounds[top - 1] = right;
+            } else {
+                bounds[top - 1] = left.w < right.w ? left : right;
+            }
+            const int begin = begins[top - 1];
+            uSdfOps[i].inner = uSdfOps[begin].outer;
+            uSdfOps[i].outer = -1;
+            uSdfOps[begin].outer = i;
+        }
+        uSdfOps[i].bounds = bounds[top - 1];
+    }
+
+    // Polarity flows from the root: the left operand of a subtraction is negated. The operands of
+    // a smooth operator blend within its radius, their spheres grow by it to stay exact there.
+    int polarities[MAX_SDF_OPS];
+    float blends[MAX_SDF_OPS];
+    top = 0;
+    polarities[top] = 1;
+    blends[top] = 0.0f;
+    top++;
+    for (int i = uSdfOpsCnt - 1; i >= 0; i--) {
+        top--;
+        const int polarity = polarities[top];
+        uSdfOps[i].polarity = polarity;
+        uSdfOps[i].bounds.w += blends[top];
+        if (uSdfOps[i].op != SDF_OP_PRIM) {
+            const bool subtraction = uSdfOps[i].op == SDF_OP_SUBTRACTION
+                    || uSdfOps[i].op == SDF_OP_SMOOTH_SUBTRACTION;
+            polarities[top] = subtraction ? -polarity : polarity;
+            polarities[top + 1] = polarity;
+            blends[top] = uSdfOps[i].blend;
+            blends[top + 1] = uSdfOps[i].blend;
+            top += 2;
+        }
+    }
+}
+
+// the scene as a postfix program: primitives push a distance, operators combine the two on top
+void sdfLoadScene(const RaymarcherScene scene) {
+    uSdfPrims[0] = sdfPrimCreate(SDF_CYLINDER, v4(scene.cylALen, scene.cylARad, 0.0f, 0.0f), scene.cylAMat);
+    uSdfPrims[1] = sdfPrimCreate(SDF_CONE, v4(scene.coneBShape.x, scene.coneBShape.y, scene.coneBHeight, 0.0f),
+                          scene.coneBMat);
+    uSdfPrims[2] = sdfPrimCreate(SDF_CYLINDER, v4(scene.cylCLen, scene.cylCRad, 0.0f, 0.0f), scene.cylCMat);
+    uSdfPrims[3] = sdfPrimCreate(SDF_BOX, v3tov4(scene.boxDShape, 0.0f), scene.boxDMat);
+    uSdfPrims[4] = sdfPrimCreate(SDF_BOX, v3tov4(scene.boxEShape, 0.0f), scene.boxEMat);
+    uSdfPrims[5] = sdfPrimCreate(SDF_PRISM, v4(scene.prismFShape.x, scene.prismFShape.y, 0.0f, 0.0f), scene.prismFMat);
+    uSdfPrims[6] = sdfPrimCreate(SDF_CYLINDER, v4(scene.cylGLen, scene.cylGRad, 0.0f, 0.0f), scene.cylGMat);
+    uSdfPrims[7] = sdfPrimCreate(SDF_BOX, v3tov4(scene.boxHShape, 0.0f), scene.boxHMat);
+
+    // H - (((((B - A) + C) + D) + E) + F) + G)
+    uSdfOps[0]  = sdfOpCreate(SDF_OP_PRIM, 7);
+    uSdfOps[1]  = sdfOpCreate(SDF_OP_PRIM, 1);
+    uSdfOps[2]  = sdfOpCreate(SDF_OP_PRIM, 0);
+    uSdfOps[3]  = sdfOpCreate(SDF_OP_SUBTRACTION, 0);
+    uSdfOps[4]  = sdfOpCreate(SDF_OP_PRIM, 2);
+    uSdfOps[5]  = sdfOpCreate(SDF_OP_UNION, 0);
+    uSdfOps[6]  = sdfOpCreate(SDF_OP_PRIM, 3);
+    uSdfOps[7]  = sdfOpCreate(SDF_OP_UNION, 0);
+    uSdfOps[8]  = sdfOpCreate(SDF_OP_PRIM, 4);
+    uSdfOps[9]  = sdfOpCreate(SDF_OP_UNION, 0);
+    uSdfOps[10] = sdfOpCreate(SDF_OP_PRIM, 5);
+    uSdfOps[11] = sdfOpCreate(SDF_OP_UNION, 0);
+    uSdfOps[12] = sdfOpCreate(SDF_OP_PRIM, 6);
+    uSdfOps[13] = sdfOpCreate(SDF_OP_UNION, 0);
+    uSdfOps[14] = sdfOpCreate(SDF_OP_SUBTRACTION, 0);
+    uSdfOpsCnt = 15;
+
+    sdfPrepare();
+}
+
+// A subtree p is farther than CULL_DIST from is replaced with a bound on its distance:
+// the lower one where the subtree adds to the result, the upper one where it is subtracted.
+protected
+float sceneDist(const vec3 p) {
+    float stack[SDF_STACK];
+    int top = 0;
+    int i = 0;
+    while (i < uSdfOpsCnt) {
+        const SdfOp op = uSdfOps[i];
+        i++;
+        if (op.op == SDF_OP_PRIM) {
+            int end = op.outer;
+            while (end >= 0) {
+                const vec4 bounds = uSdfOps[end].bounds;
+                const float centerDist = lenv3(subv3(p, v4tov3(bounds)));
+                if (centerDist - bounds.w > CULL_DIST) {
+                    break;
+                }
+                end = uSdfOps[end].inner;
+            }
+            if (end >= 0) {
+                const vec4 bounds = uSdfOps[end].bounds;
+                const float centerDist = lenv3(subv3(p, v4tov3(bounds)));
+                stack[top] = uSdfOps[end].polarity > 0 ? centerDist - bounds.w : centerDist + bounds.w;
+                i = end + 1;
+            } else {
+                stack[top] = sdfPrimDist(p, uSdfPrims[op.index]);
+            }
+            top++;
+        } else {
+            top--;
+            const float left = stack[top - 1];
+            const float right = stack[top];
+            if (op.op == SDF_OP_UNION) {
+                stack[top - 1] = opUnion(left, right);
+            } else if (op.op == SDF_OP_SUBTRACTION) {
+                stack[top - 1] = opSubtraction(left, right);
+            } else if (op.op == SDF_OP_INTERSECTION) {
+                stack[top - 1] = opIntersection(left, right);
+            } else if (op.op == SDF_OP_SMOOTH_UNION) {
+                stack[top - 1] = opSmoothUnion(left, right, op.blend);
+            } else if (op.op == SDF_OP_SMOOTH_SUBTRACTION) {
+                stack[top - 1] = opSmoothSubtraction(left, right, op.blend);
+            } else {
+                stack[top - 1] = opSmoothIntersection(left, right, op.blend);
+            }
+        }
+    }
+    return stack[0];
+}
+
+protected
+vec4 sdfGradNeg(const vec4 grad) {
+    return v3tov4(negv3(v4tov3(grad)), -grad.w);
+}
+
+// opSmoothUnion with the gradients mixed by how much each operand moves the result
+protected
+vec4 sdfSmoothGrad(const vec4 left, const vec4 right, const float k) {
+    const float h = maxf(k - absf(left.w - right.w), 0.0f) / k;
+    const vec4 closer = left.w < right.w ? left : right;
+    const vec4 farther = left.w < right.w ? right : left;
+    return v3tov4(mixv3(v4tov3(closer), v4tov3(farther), h * 0.5f), opSmoothUnion(left.w, right.w, k));
+}
+
+// sceneDist with the gradient of the operand that wins every hard operator
+protected
+vec4 sceneDistGrad(const vec3 p) {
+    vec4 stack[SDF_STACK];
+    int top = 0;
+    int i = 0;
+    while (i < uSdfOpsCnt) {
+        const SdfOp op = uSdfOps[i];
+        i++;
+        if (op.op == SDF_OP_PRIM) {
+            int end = op.outer;
+            while (end >= 0) {
+                const vec4 bounds = uSdfOps[end].bounds;
+                const float centerDist = lenv3(subv3(p, v4tov3(bounds)));
+                if (centerDist - bounds.w > CULL_DIST) {
+                    break;
+                }
+                end = uSdfOps[end].inner;
+            }
+            if (end >= 0) {
+                const vec4 bounds = uSdfOps[end].bounds;
+                const vec3 away = subv3(p, v4tov3(bounds));
+                const float centerDist = lenv3(away);
+                const float dist = uSdfOps[end].polarity > 0 ? centerDist - bounds.w : centerDist + bounds.w;
+                stack[top] = v3tov4(divv3f(away, centerDist), dist);
+                i = end + 1;
+            } else {
+                stack[top] = sdfPrimGrad(p, uSdfPrims[op.index]);
+            }
+            top++;
+        } else {
+            top--;
+            const vec4 left = stack[top - 1];
+            const vec4 right = stack[top];
+            if (op.op == SDF_OP_UNION) {
+                stack[top - 1] = left.w < right.w ? left : right;
+            } else if (op.op == SDF_OP_SUBTRACTION) {
+                stack[top - 1] = -left.w > right.w ? sdfGradNeg(left) : right;
+            } else if (op.op == SDF_OP_INTERSECTION) {
+                stack[top - 1] = left.w > right.w ? left : right;
+            } else if (op.op == SDF_OP_SMOOTH_UNION) {
+                stack[top - 1] = sdfSmoothGrad(left, right, op.blend);
+            } else if (op.op == SDF_OP_SMOOTH_SUBTRACTION) {
+                stack[top - 1] = sdfGradNeg(sdfSmoothGrad(left, sdfGradNeg(right), op.blend));
+            } else {
+                stack[top - 1] = sdfGradNeg(sdfSmoothGrad(sdfGradNeg(left), sdfGradNeg(right), op.blend));
+            }
+        }
+    }
+    return stack[0];
+}
+
+protected
+float rayMarch(const vec3 ro, const vec3 rd) {
     float dO = 0.0f;
     for(int i = 0; i < MAX_STEPS; i++) {
         const vec3 p = addv3(ro, mulv3f(rd, dO));
-        const float dS = sceneDist(p, scene);
+        const float dS = sceneDist(p);
         dO += dS;
         if(dO > MAX_DIST || dS < MIN_DIST) break;
     }
     return dO;
 }
 
+// a hit is closer than the pixel footprint at t, but never closer than MIN_DIST
+protected
+float marchEpsilon(const float t, const float pixelRadius) {
+    return maxf(MIN_DIST, pixelRadius * t);
+}
+
+// MARCH_RELAXED over-steps by MARCH_RELAXATION and falls back to a plain step when the spheres
+// stop overlapping (Keinert et al., enhanced sphere tracing). Out of steps, it returns the
+// point closest to the surface relative to the epsilon.
 protected
-vec3 getNormal(const vec3 p, const RaymarcherScene scene) {
-    const float d = sceneDist(p, scene);
-    const vec3 n = subv3(ftov3(d), v3(
-            sceneDist(v3(p.x - MIN_DIST, p.y,            p.z),            scene),
-            sceneDist(v3(p.x,            p.y - MIN_DIST, p.z),            scene),
-            sceneDist(v3(p.x,            p.y,            p.z - MIN_DIST), scene)));
+MarchResult rayMarchMode(const vec3 ro, const vec3 rd, const int mode, const float pixelRadius) {
+    float omega = mode == MARCH_RELAXED ? MARCH_RELAXATION : 1.0f;
+    float t = 0.0f;
+    float stepLen = 0.0f;
+    float prevRadius = 0.0f;
+    float candidateT = 0.0f;
+    float candidateErr = FLT_MAX;
+    bool finished = false;
+    int steps = 0;
+    for (int i = 0; i < MAX_STEPS; i++) {
+        steps++;
+        const float dS = sceneDist(addv3(ro, mulv3f(rd, t)));
+        const float radius = absf(dS);
+        const bool sorFail = omega > 1.0f && radius + prevRadius < stepLen;
+        if (sorFail) {
+            stepLen -= omega * stepLen;
+            omega = 1.0f;
+        } else {
+            stepLen = dS * omega;
+            const float epsilon = marchEpsilon(t, pixelRadius);
+            const float err = radius / epsilon;
+            if (err < candidateErr) {
+                candidateT = t;
+                candidateErr = err;
+            }
+            if (dS < epsilon) {
+                finished = true;
+                break;
+            }
+        }
+        prevRadius = radius;
+        t += stepLen;
+        if (t > MAX_DIST) {
+            finished = true;
+            break;
+        }
+    }
+    const MarchResult result = { finished ? t : candidateT, steps };
+    return result;
+}
+
+// four taps on the corners of a tetrahedron, central differences without the centre
+protected
+vec3 getNormal(const vec3 p) {
+    const vec3 k0 = v3( 1.0f, -1.0f, -1.0f);
+    const vec3 k1 = v3(-1.0f, -1.0f,  1.0f);
+    const vec3 k2 = v3(-1.0f,  1.0f, -1.0f);
+    const vec3 k3 = v3( 1.0f,  1.0f,  1.0f);
+    const vec3 n = addv3(
+            addv3(mulv3f(k0, sceneDist(addv3(p, mulv3f(k0, MIN_DIST)))),
+                  mulv3f(k1, sceneDist(addv3(p, mulv3f(k1, MIN_DIST))))),
+            addv3(mulv3f(k2, sceneDist(addv3(p, mulv3f(k2, MIN_DIST)))),
+                  mulv3f(k3, sceneDist(addv3(p, mulv3f(k3, MIN_DIST))))));
     return normv3(n);
 }
 
+// one pass over the program, the tetrahedron is only left for cylinders, cones and prisms
+protected
+vec3 getNormalAnalytic(const vec3 p) {
+    return normv3(v4tov3(sceneDistGrad(p)));
+}
+
+// IQ's soft shadow: the narrowest cone around the ray toward the light, 0 when occluded.
+// Bounded by the light distance, and stops as soon as the penumbra is fully dark.
 protected
-float getLight(const vec3 p, const vec3 eye, const RaymarcherScene scene) {
+float shadowSoft(const vec3 ro, const vec3 rd, const float maxT) {
+    float res = 1.0f;
+    float t = MIN_DIST;
+    for (int i = 0; i < MAX_STEPS; i++) {
+        const float h = sceneDist(addv3(ro, mulv3f(rd, t)));
+        res = minf(res, SHADOW_SOFTNESS * h / t);
+        if (res < MIN_DIST) {
+            return 0.0f;
+        }
+        t += clampf(h, MIN_DIST, maxT);
+        if (t > maxT) {
+            break;
+        }
+    }
+    return clampf(res, 0.0f, 1.0f);
+}
+
+protected
+float getLightMode(const vec3 p, const vec3 eye, const int shadow) {
     const vec3 l = normv3(subv3(eye, p));
-    const vec3 n = getNormal(p, scene);
+    const vec3 n = getNormalAnalytic(p);
+    const vec3 ro = addv3(p, mulv3f(n, MIN_DIST * 2.0f));
+    const float lightDist = lenv3(subv3(eye, p));
 
     float a = clampf(dotv3(n, l), 0.0f, 1.0f);
-    float d = rayMarch(addv3(p, mulv3f(n, MIN_DIST * 2.0f)), l, scene);
-    if(d < lenv3(subv3(eye, p))) a *= 0.1f;
+    if (shadow == SHADOW_SOFT) {
+        a *= 0.1f + 0.9f * shadowSoft(ro, l, lightDist);
+    } else {
+        float d = rayMarch(ro, l);
+        if(d < lightDist) a *= 0.1f;
+    }
 
     return a;
 }
 
-public
-vec4 raymarcher(
-        const vec3 eye, const vec3 center, vec2 uv, float fovy, float aspect, const ivec2 wh, const int samplesAA,
-        
-        float cylALen,      float cylARad,      mat4 cylAMat,
-        vec2 coneBShape,    float coneBHeight,  mat4 coneBMat,
-        float cylCLen,      float cylCRad,      mat4 cylCMat,
-        vec3 boxDShape,     mat4 boxDMat,
-        vec3 boxEShape,     mat4 boxEMat,
-        vec2 prismFShape,   mat4 prismFMat,
-        float cylGLen,      float cylGRad,      mat4 cylGMat,
-        vec3 boxHShape,     mat4 boxHMat) {
-
-    const RaymarcherScene scene = { cylALen, cylARad, cylAMat,
-                                    coneBShape, coneBHeight, coneBMat,
-                                    cylCLen, cylCRad, cylCMat,
-                                    boxDShape, boxDMat,
-                                    boxEShape, boxEMat,
-                                    prismFShape, prismFMat,
-                                    cylGLen, cylGRad, cylGMat,
-                                    boxHShape, boxHMat };
+protected
+float getLight(const vec3 p, const vec3 eye) {
+    return getLightMode(p, eye, SHADOW_HARD);
+}
 
+// renders whatever program is loaded into uSdfPrims/uSdfOps
+public
+vec4 raymarcherSdfMode(const vec3 eye, const vec3 center, vec2 uv, float fovy, float aspect, const ivec2 wh,
+                       const int samplesAA, const int mode, const int shadow) {
     Camera camera = cameraLookAt(eye, center, v3up(), fovy, aspect, 0.0f, 1.0f);
+    const float pixelRadius = tanf(fovy / 2.0f) / itof(wh.y);
 
     vec3 col = v3zero();
     for(int x = 0; x < samplesAA; x++) {
@@ -129,10 +667,10 @@ vec4 raymarcher(
             const float dv = (itof(y) / itof(samplesAA) - 0.5f) / itof(wh.y);
             const ray r = rayFromCamera(camera, addv2(uv, v2(du, dv)));
 
-            const float d = rayMarch(r.origin, r.direction, scene);
+            const float d = rayMarchMode(r.origin, r.direction, mode, pixelRadius).t;
             const vec3 p = addv3(r.origin, mulv3f(r.direction, d));
 
-            const vec3 addition = ftov3(getLight(p, eye, scene));
+            const vec3 addition = ftov3(getLightMode(p, eye, shadow));
             col = addv3(col, sqrtv3(addition));
         }
     }
@@ -140,3 +678,287 @@ vec4 raymarcher(
     col = divv3f(col, itof(samplesAA * samplesAA));
     return v3tov4(col, 1.0f);
 }
+
+public
+vec4 raymarcherSdf(const vec3 eye, const vec3 center, vec2 uv, float fovy, float aspect, const ivec2 wh,
+                   const int samplesAA) {
+    return raymarcherSdfMode(eye, center, uv, fovy, aspect, wh, samplesAA, MARCH_PLAIN, SHADOW_HARD);
+}
+
+// the program is per thread, workers pick up a copy
+void sdfProgramSave(SdfProgram *program) {
+    memcpy(program->prims, uSdfPrims, sizeof(program->prims));
+    memcpy(program->ops, uSdfOps, sizeof(program->ops));
+    program->opsCnt = uSdfOpsCnt;
+}
+
+void sdfProgramLoad(const SdfProgram *program) {
+    memcpy(uSdfPrims, program->prims, sizeof(program->prims));
+    memcpy(uSdfOps, program->ops, sizeof(program->ops));
+    uSdfOpsCnt = program->opsCnt;
+}
+
+typedef struct RmTiles {
+    const RmParams *params;
+    SdfProgram program;
+    vec4 *pixels;
+    float *depths;
+    vec3 *normals;
+    atomic_int refined;
+    atomic_long steps[RM_HISTOGRAM];
+} RmTiles;
+
+static void raymarcherCount(long *histogram, const int steps) {
+    histogram[(steps - 1) * RM_HISTOGRAM / MAX_STEPS]++;
+}
+
+static void raymarcherMerge(RmTiles *tiles, const long *histogram) {
+    for (int i = 0; i < RM_HISTOGRAM; i++) {
+        atomic_fetch_add(&tiles->steps[i], histogram[i]);
+    }
+}
+
+static vec2 raymarcherUV(const RmParams *params, const int x, const int y) {
+    return v2((itof(x) + 0.5f) / itof(params->width), (itof(params->height - 1 - y) + 0.5f) / itof(params->height));
+}
+
+// host twin of raymarcherSdfMode, counts the steps of every primary ray
+static vec4 raymarcherPixel(const RmParams *params, const Camera camera, const int x, const int y, long *histogram) {
+    const vec2 uv = raymarcherUV(params, x, y);
+    const float pixelRadius = tanf(params->fovy / 2.0f) / itof(params->height);
+    vec3 col = v3zero();
+    for (int sx = 0; sx < params->samplesAA; sx++) {
+        for (int sy = 0; sy < params->samplesAA; sy++) {
+            const float du = (itof(sx) / itof(params->samplesAA) - 0.5f) / itof(params->width);
+            const float dv = (itof(sy) / itof(params->samplesAA) - 0.5f) / itof(params->height);
+            const ray r = rayFromCamera(camera, addv2(uv, v2(du, dv)));
+
+            const MarchResult march = rayMarchMode(r.origin, r.direction, params->mode, pixelRadius);
+            raymarcherCount(histogram, march.steps);
+            const vec3 p = addv3(r.origin, mulv3f(r.direction, march.t));
+            col = addv3(col, sqrtv3(ftov3(getLightMode(p, params->eye, params->shadow))));
+        }
+    }
+    return v3tov4(divv3f(col, itof(params->samplesAA * params->samplesAA)), 1.0f);
+}
+
+static Camera raymarcherCamera(const RmParams *params) {
+    return cameraLookAt(params->eye, params->center, v3up(), params->fovy, params->aspect, 0.0f, 1.0f);
+}
+
+// one ray through the centre of the pixel, keeps what the edge test needs
+static void raymarcherCoarseTile(const int x0, const int y0, const int x1, const int y1, void *context) {
+    RmTiles *tiles = context;
+    const RmParams *params = tiles->params;
+    sdfProgramLoad(&tiles->program);
+    const Camera camera = raymarcherCamera(params);
+    const float pixelRadius = tanf(params->fovy / 2.0f) / itof(params->height);
+    long histogram[RM_HISTOGRAM] = { 0 };
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            const int index = y * params->width + x;
+            const ray r = rayFromCamera(camera, raymarcherUV(params, x, y));
+            const MarchResult march = rayMarchMode(r.origin, r.direction, params->mode, pixelRadius);
+            raymarcherCount(histogram, march.steps);
+            const float d = march.t;
+            const vec3 p = addv3(r.origin, mulv3f(r.direction, d));
+            tiles->pixels[index] = v3tov4(sqrtv3(ftov3(getLightMode(p, params->eye, params->shadow))), 1.0f);
+            tiles->depths[index] = d;
+            tiles->normals[index] = d > MAX_DIST ? v3zero() : getNormalAnalytic(p);
+        }
+    }
+    raymarcherMerge(tiles, histogram);
+}
+
+static bool raymarcherEdge(const RmTiles *tiles, const int index, const int other) {
+    const float depth = tiles->depths[index];
+    const float otherDepth = tiles->depths[other];
+    if ((depth > MAX_DIST) != (otherDepth > MAX_DIST)) {
+        return true;
+    }
+    if (depth > MAX_DIST) {
+        return false;
+    }
+    return absf(depth - otherDepth) > RM_EDGE_DEPTH * minf(depth, otherDepth)
+           || dotv3(tiles->normals[index], tiles->normals[other]) < RM_EDGE_NORMAL;
+}
+
+// supersamples only where a neighbour disagrees on the hit, the depth or the normal
+static void raymarcherRefineTile(const int x0, const int y0, const int x1, const int y1, void *context) {
+    RmTiles *tiles = context;
+    const RmParams *params = tiles->params;
+    sdfProgramLoad(&tiles->program);
+    const Camera camera = raymarcherCamera(params);
+    long histogram[RM_HISTOGRAM] = { 0 };
+    int refined = 0;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            const int index = y * params->width + x;
+            const bool edge = (x > 0 && raymarcherEdge(tiles, index, index - 1))
+                    || (x < params->width - 1 && raymarcherEdge(tiles, index, index + 1))
+                    || (y > 0 && raymarcherEdge(tiles, index, index - params->width))
+                    || (y < params->height - 1 && raymarcherEdge(tiles, index, index + params->width));
+            if (edge) {
+                tiles->pixels[index] = raymarcherPixel(params, camera, x, y, histogram);
+                refined++;
+            }
+        }
+    }
+    atomic_fetch_add(&tiles->refined, refined);
+    raymarcherMerge(tiles, histogram);
+}
+
+static void raymarcherFullTile(const int x0, const int y0, const int x1, const int y1, void *context) {
+    RmTiles *tiles = context;
+    const RmParams *params = tiles->params;
+    sdfProgramLoad(&tiles->program);
+    const Camera camera = raymarcherCamera(params);
+    long histogram[RM_HISTOGRAM] = { 0 };
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            tiles->pixels[y * params->width + x] = raymarcherPixel(params, camera, x, y, histogram);
+        }
+    }
+    raymarcherMerge(tiles, histogram);
+}
+
+// renders the program loaded on the calling thread, returns the count of supersampled pixels
+int raymarcherRender(const RmParams *params, vec4 *pixels, RmStats *stats, const int threadsCnt) {
+    RmTiles tiles;
+    tiles.params = params;
+    sdfProgramSave(&tiles.program);
+    tiles.pixels = pixels;
+    tiles.depths = NULL;
+    tiles.normals = NULL;
+    atomic_init(&tiles.refined, 0);
+    for (int i = 0; i < RM_HISTOGRAM; i++) {
+        atomic_init(&tiles.steps[i], 0);
+    }
+
+    const bool adaptive = params->adaptive && params->samplesAA > 1;
+    if (adaptive) {
+        const int count = params->width * params->height;
+        tiles.depths = malloc(sizeof(float) * count);
+        tiles.normals = malloc(sizeof(vec3) * count);
+    }
+
+    // without the coarse buffers every pixel takes all of its samples
+    int refined;
+    if (!adaptive || tiles.depths == NULL || tiles.normals == NULL) {
+        parallelTiles(params->width, params->height, RM_TILE, RM_TILE, threadsCnt, raymarcherFullTile, &tiles);
+        refined = params->samplesAA > 1 ? params->width * params->height : 0;
+    } else {
+        parallelTiles(params->width, params->height, RM_TILE, RM_TILE, threadsCnt, raymarcherCoarseTile, &tiles);
+        parallelTiles(params->width, params->height, RM_TILE, RM_TILE, threadsCnt, raymarcherRefineTile, &tiles);
+        refined = atomic_load(&tiles.refined);
+    }
+    free(tiles.depths);
+    free(tiles.normals);
+
+    if (stats != NULL) {
+        stats->rays = 0;
+        for (int i = 0; i < RM_HISTOGRAM; i++) {
+            stats->steps[i] = atomic_load(&tiles.steps[i]);
+            stats->rays += stats->steps[i];
+        }
+    }
+    return refined;
+}
+
+static bool raymarcherRecipeScene(const Recipe *recipe, RaymarcherScene *scene) {
+    vec4 v;
+    bool found = true;
+    found = found && recipeGetFloat(recipe, "cylALen", &scene->cylALen);
+    found = found && recipeGetFloat(recipe, "cylARad", &scene->cylARad);
+    found = found && recipeGetMat4(recipe, "cylAMat", &scene->cylAMat);
+    found = found && recipeGetVec(recipe, "coneBShape", RECIPE_VEC2, &v);
+    scene->coneBShape = v2(v.x, v.y);
+    found = found && recipeGetFloat(recipe, "coneBHeight", &scene->coneBHeight);
+    found = found && recipeGetMat4(recipe, "coneBMat", &scene->coneBMat);
+    found = found && recipeGetFloat(recipe, "cylCLen", &scene->cylCLen);
+    found = found && recipeGetFloat(recipe, "cylCRad", &scene->cylCRad);
+    found = found && recipeGetMat4(recipe, "cylCMat", &scene->cylCMat);
+    found = found && recipeGetVec(recipe, "boxDShape", RECIPE_VEC3, &v);
+    scene->boxDShape = v4tov3(v);
+    found = found && recipeGetMat4(recipe, "boxDMat", &scene->boxDMat);
+    found = found && recipeGetVec(recipe, "boxEShape", RECIPE_VEC3, &v);
+    scene->boxEShape = v4tov3(v);
+    found = found && recipeGetMat4(recipe, "boxEMat", &scene->boxEMat);
+    found = found && recipeGetVec(recipe, "prismFShape", RECIPE_VEC2, &v);
+    scene->prismFShape = v2(v.x, v.y);
+    found = found && recipeGetMat4(recipe, "prismFMat", &scene->prismFMat);
+    found = found && recipeGetFloat(recipe, "cylGLen", &scene->cylGLen);
+    found = found && recipeGetFloat(recipe, "cylGRad", &scene->cylGRad);
+    found = found && recipeGetMat4(recipe, "cylGMat", &scene->cylGMat);
+    found = found && recipeGetVec(recipe, "boxHShape", RECIPE_VEC3, &v);
+    scene->boxHShape = v4tov3(v);
+    found = found && recipeGetMat4(recipe, "boxHMat", &scene->boxHMat);
+    return found;
+}
+
+// CPU reference for the raymarcher recipes: the same labels as the shader, the camera from the
+// optional eye/center/width/height labels, otherwise the first stop of the scenic controller
+void raymarcherRecipe(const char *path, const bool adaptive) {
+    static Recipe recipe;
+    RaymarcherScene scene;
+    if (!recipeLoad(&recipe, path)) {
+        if (recipe.errorLine > 0) {
+            printf("Cannot parse line #%d of the recipe %s!\n", recipe.errorLine, path);
+        } else {
+            printf("Error loading the recipe %s!\n", path);
+        }
+        exit(1);
+    }
+    if (!raymarcherRecipeScene(&recipe, &scene)) {
+        printf("Error loading the recipe %s!\n", path);
+        exit(1);
+    }
+    sdfLoadScene(scene);
+
+    RmParams params = {
+            1024, 768, 1,
+            v3(-13.0f, 8.0f, -13.0f), v3zero(),
+            90.0f * PI / 180.0f, 4.0f / 3.0f,
+            MARCH_RELAXED, SHADOW_SOFT, adaptive };
+    vec4 v;
+    recipeGetInt(&recipe, "samplesAA", &params.samplesAA);
+    recipeGetInt(&recipe, "width", &params.width);
+    recipeGetInt(&recipe, "height", &params.height);
+    recipeGetInt(&recipe, "march", &params.mode);
+    recipeGetInt(&recipe, "shadow", &params.shadow);
+    recipeGetFloat(&recipe, "fovy", &params.fovy);
+    if (recipeGetVec(&recipe, "eye", RECIPE_VEC3, &v)) {
+        params.eye = v4tov3(v);
+    }
+    if (recipeGetVec(&recipe, "center", RECIPE_VEC3, &v)) {
+        params.center = v4tov3(v);
+    }
+    params.aspect = itof(params.width) / itof(params.height);
+
+    struct timespec start;
+    struct timespec end;
+    RmStats stats;
+    vec4 *pixels = malloc(sizeof(vec4) * params.width * params.height);
+    if (pixels == NULL) {
+        printf("Not enough memory for %dx%d!\n", params.width, params.height);
+        exit(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const int refined = raymarcherRender(&params, pixels, &stats, parallelThreads());
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    printf("frame: %dx%d in %.3fs, %ld rays, %d pixels supersampled\n",
+           params.width, params.height, seconds, stats.rays, refined);
+    for (int i = 0; i < RM_HISTOGRAM; i++) {
+        printf("steps %3d-%3d: %ld (%.1f%%)\n", i * MAX_STEPS / RM_HISTOGRAM + 1, (i + 1) * MAX_STEPS / RM_HISTOGRAM,
+               stats.steps[i], 100.0 * (double) stats.steps[i] / (double) (stats.rays > 0 ? stats.rays : 1));
+    }
+
+    if (!imageWritePpm("out.ppm", pixels, params.width, params.height)
+            || !imageWritePfm("out.pfm", pixels, params.width, params.height)) {
+        printf("Error writing file!\n");
+        exit(1);
+    }
+    free(pixels);
+}
@@ -5,9 +5,14 @@
 #include "lang.h"
 
 #include <float.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#define RT_TILE 16
+#define RT_MIN_PASSES 4
+#define RT_MATERIALS (MATERIAL_DIELECTRIC + 1)
+
 // region ------------------- RAYTRACING ---------------
 
 protected
@@ -80,7 +85,8 @@ HitRecord rayHitObject(const ray ray, const float tMin, const float tMax, const
 
 protected
 HitRecord rayHitBvh(const ray ray, const float tMin, const float tMax, const int index) {
-    bvhTop = 0;
+    int bvhStack[BVH_STACK];
+    int bvhTop = 0;
     float closest = tMax;
     HitRecord result = NO_HIT;
     int curr = index;
@@ -113,11 +119,6 @@ HitRecord rayHitBvh(const ray ray, const float tMin, const float tMax, const int
     return result;
 }
 
-protected
-HitRecord rayHitWorld(const ray ray, const float tMin, const float tMax) {
-    return rayHitBvh(ray, tMin, tMax, 0);
-}
-
 protected
 ScatterResult scatterLambertian(HitRecord record, LambertianMaterial material) {
     const vec3 tangent = addv3(record.point, record.normal);
@@ -238,49 +239,304 @@ vec4 gammaSqrt(const vec4 result) {
     return v4(sqrtf(result.x), sqrtf(result.y), sqrtf(result.z), 1.0f);
 }
 
-void raytracer() {
-    const int WIDTH = 1024;
-    const int HEIGHT = 768;
-    const int SAMPLES = 8;
+typedef struct RtPath {
+    ray ray;
+    vec3 fraction;
+    vec4 seed;
+    HitRecord record;
+    int pixel;
+} RtPath;
+
+// Wavefront twin of fragmentColorRt for a whole tile: each stage runs over all live paths before the next one -
+// camera rays, intersection, compaction of the finished paths, then scattering sorted by material.
+// Samples are waves in order and every path carries the seed of its pixel, so the draws match fragmentColorRt.
+static void raytracerWave(const RtParams *params, const float random,
+                          const int x0, const int y0, const int x1, const int y1, vec3 *sums) {
+    RtPath paths[RT_TILE * RT_TILE];
+    RtPath sorted[RT_TILE * RT_TILE];
+    vec4 seeds[RT_TILE * RT_TILE];
+    vec2 texCoords[RT_TILE * RT_TILE];
+    const int tileW = x1 - x0;
+    const int count = tileW * (y1 - y0);
+
+    const float DU = 1.0f / itof(params->width);
+    const float DV = 1.0f / itof(params->height);
+
+    const Camera camera = cameraLookAt(params->eye, params->center, params->up,
+                                       params->fovy, params->aspect, params->aperture, params->focusDist);
+    for (int i = 0; i < count; i++) {
+        const int x = x0 + i % tileW;
+        const int y = y0 + i / tileW;
+        texCoords[i] = v2(itof(x) / itof(params->width), itof(params->height - 1 - y) / itof(params->height));
+        seedRandom(v2tov3(texCoords[i], random));
+        seeds[i] = seedSave();
+        sums[i] = v3zero();
+    }
+
+    for (int sample = 0; sample < params->samples; sample++) {
+        for (int i = 0; i < count; i++) {
+            seedRestore(seeds[i]);
+            const float du = DU * seededRndf();
+            const float dv = DV * seededRndf();
+            const ray ray = rayFromCamera(camera, addv2(texCoords[i], v2(du, dv)));
+            const RtPath path = { ray, ftov3(1.0f), seedSave(), NO_HIT, i };
+            paths[i] = path;
+        }
 
-    FILE *f = fopen("out.ppm", "w");
-    if (f == NULL) {
-        printf("Error opening file!\n");
-        exit(1);
+        int live = count;
+        for (int bounce = 0; bounce < params->bounces && live > 0; bounce++) {
+            for (int i = 0; i < live; i++) {
+                paths[i].record = rayHitWorld(paths[i].ray, BOUNCE_ERR, FLT_MAX);
+            }
+
+            int buckets[RT_MATERIALS + 1] = { 0 };
+            int hits = 0;
+            for (int i = 0; i < live; i++) {
+                const RtPath *path = &paths[i];
+                if (path->record.t < 0) {
+                    sums[path->pixel] = addv3(sums[path->pixel], mulv3(background(path->ray), path->fraction));
+                    seeds[path->pixel] = path->seed;
+                } else {
+                    paths[hits++] = *path;
+                    buckets[path->record.materialType + 1]++;
+                }
+            }
+
+            for (int i = 1; i <= RT_MATERIALS; i++) {
+                buckets[i] += buckets[i - 1];
+            }
+            for (int i = 0; i < hits; i++) {
+                sorted[buckets[paths[i].record.materialType]++] = paths[i];
+            }
+
+            live = 0;
+            for (int i = 0; i < hits; i++) {
+                RtPath path = sorted[i];
+                seedRestore(path.seed);
+                const ScatterResult scatterResult = scatterMaterial(path.ray, path.record);
+                path.seed = seedSave();
+                if (scatterResult.attenuation.x < 0) {
+                    seeds[path.pixel] = path.seed; // absorbed, adds nothing
+                } else {
+                    path.fraction = mulv3(path.fraction, scatterResult.attenuation);
+                    path.ray = scatterResult.scattered;
+                    paths[live++] = path;
+                }
+            }
+        }
+
+        for (int i = 0; i < live; i++) {
+            const RtPath *path = &paths[i];
+            sums[path->pixel] = addv3(sums[path->pixel], mulv3(background(path->ray), path->fraction));
+            seeds[path->pixel] = path->seed;
+        }
+    }
+}
+
+typedef struct RtTiles {
+    const RtParams *params;
+    vec4 *pixels;
+    const ImageStream *stream;
+    atomic_bool streamFailed;
+    atomic_int tilesDone;
+    int tilesCnt;
+} RtTiles;
+
+static vec4 raytracerPixel(const RtParams *params, const float random, const int x, const int y) {
+    const vec2 texCoord = v2(itof(x) / itof(params->width), itof(params->height - 1 - y) / itof(params->height));
+    return fragmentColorRt(params->width, params->height,
+                           random, params->samples, params->bounces,
+                           params->eye, params->center, params->up,
+                           params->fovy, params->aspect, params->aperture, params->focusDist,
+                           texCoord);
+}
+
+static void raytracerProgress(atomic_int *tilesDone, const int tilesCnt) {
+    const int done = atomic_fetch_add(tilesDone, 1) + 1;
+    if (done * 100 / tilesCnt != (done - 1) * 100 / tilesCnt) {
+        fprintf(stderr, "progress: %.2f\n", itof(done) / itof(tilesCnt));
     }
-    fprintf(f, "P3\n%d %d\n255\n", WIDTH, HEIGHT);
-
-    const float all = itof(WIDTH) * itof(HEIGHT);
-    int current = 0;
-
-    for (int v = HEIGHT - 1; v >= 0; v--) {
-        for (int u = 0; u < WIDTH; u++) {
-            const float s = (float) u / (float) WIDTH;
-            const float t = (float) v / (float) WIDTH;
-
-            const vec4 added = fragmentColorRt(
-                    WIDTH, HEIGHT,
-                    seededRndf(), SAMPLES, 4,
-                    v3(0, 0, 250.0f), v3zero(), v3up(),
-                    90.0f * PI / 180.0f, 4.0f / 3.0f, 0, 1,
-                    v2(s, t));
-            const vec4 color = divv4f(added, itof(SAMPLES));
-
-            const int r = (int) (255.9f * color.x);
-            const int g = (int) (255.9f * color.y);
-            const int b = (int) (255.9f * color.z);
-            fprintf(f, "%d %d %d ", r, g, b);
-
-            static float prevReport = 0.0f;
-            float progress = (float) (current++) / all;
-            if (progress - prevReport > 0.01f) {
-                printf("progress: %.2f\n", progress);
-                prevReport = progress;
+}
+
+static void raytracerTile(const int x0, const int y0, const int x1, const int y1, void *context) {
+    RtTiles *tiles = context;
+    const RtParams *params = tiles->params;
+    if (params->wavefront) {
+        vec3 sums[RT_TILE * RT_TILE];
+        raytracerWave(params, params->random, x0, y0, x1, y1, sums);
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                const vec4 added = v3tov4(sums[(y - y0) * (x1 - x0) + (x - x0)], 1.0f);
+                tiles->pixels[y * params->width + x] = divv4f(added, itof(params->samples));
+            }
+        }
+    } else {
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                const vec4 added = raytracerPixel(params, params->random, x, y);
+                tiles->pixels[y * params->width + x] = divv4f(added, itof(params->samples));
+            }
+        }
+    }
+
+    if (tiles->stream != NULL && !imageStreamTile(tiles->stream, tiles->pixels, x0, y0, x1, y1)) {
+        atomic_store(&tiles->streamFailed, true);
+    }
+    raytracerProgress(&tiles->tilesDone, tiles->tilesCnt);
+}
+
+// false when a tile did not make it into the stream, the framebuffer is complete either way
+bool raytracerRender(const RtParams *params, vec4 *pixels, const ImageStream *stream, const int threadsCnt) {
+    bvhUploadWide();
+
+    RtTiles tiles;
+    tiles.params = params;
+    tiles.pixels = pixels;
+    tiles.stream = stream;
+    atomic_init(&tiles.streamFailed, false);
+    atomic_init(&tiles.tilesDone, 0);
+    tiles.tilesCnt = ((params->width + RT_TILE - 1) / RT_TILE) * ((params->height + RT_TILE - 1) / RT_TILE);
+    parallelTiles(params->width, params->height, RT_TILE, RT_TILE, threadsCnt, raytracerTile, &tiles);
+    return !atomic_load(&tiles.streamFailed);
+}
+
+typedef struct RtPasses {
+    const RtParams *params;
+    RtAccum *accum;
+    vec4 *estimate;
+    float random;
+    float threshold;
+    atomic_int active;
+} RtPasses;
+
+static void raytracerPassTile(const int x0, const int y0, const int x1, const int y1, void *context) {
+    RtPasses *passes = context;
+    const RtParams *params = passes->params;
+    int active = 0;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            const int index = y * params->width + x;
+            RtAccum *accum = &passes->accum[index];
+            if (accum->converged) {
+                continue;
+            }
+
+            const vec3 added = v4tov3(raytracerPixel(params, passes->random, x, y));
+            accum->sum = addv3(accum->sum, added);
+            accum->samples += params->samples;
+            passes->estimate[index] = v3tov4(divv3f(accum->sum, itof(accum->samples)), 1.0f);
+
+            // Welford over the luminance of the pass estimates
+            const float luma = dotv3(added, v3(0.2126f, 0.7152f, 0.0722f)) / itof(params->samples);
+            accum->passes++;
+            const float delta = luma - accum->mean;
+            accum->mean += delta / itof(accum->passes);
+            accum->m2 += delta * (luma - accum->mean);
+
+            if (passes->threshold > 0.0f && accum->passes >= RT_MIN_PASSES) {
+                const float n = itof(accum->passes);
+                const float stdErr = sqrtf(accum->m2 / (n - 1.0f) / n);
+                accum->converged = stdErr < passes->threshold;
+            }
+            if (!accum->converged) {
+                active++;
             }
         }
-        fprintf(f, "\n");
     }
-    fclose(f);
+    atomic_fetch_add(&passes->active, active);
+}
+
+// returns the passes it took, -1 when the accumulators do not fit
+int raytracerProgressive(const RtParams *params, const int passesMax, const float threshold,
+                         vec4 *estimate, const RtPassFunc callback, void *context, const int threadsCnt) {
+    bvhUploadWide();
+
+    const int count = params->width * params->height;
+    RtAccum *accum = calloc(count, sizeof(RtAccum));
+    if (accum == NULL) {
+        return -1;
+    }
+
+    RtPasses passes;
+    passes.params = params;
+    passes.accum = accum;
+    passes.estimate = estimate;
+    passes.threshold = threshold;
+
+    int pass = 0;
+    while (pass < passesMax) {
+        passes.random = rndv2(v2(params->random, itof(pass)));
+        atomic_init(&passes.active, 0);
+        parallelTiles(params->width, params->height, RT_TILE, RT_TILE, threadsCnt, raytracerPassTile, &passes);
+        pass++;
+
+        const int active = atomic_load(&passes.active);
+        if (callback != NULL) {
+            callback(pass, estimate, active, context);
+        }
+        if (active == 0) {
+            break;
+        }
+    }
+
+    free(accum);
+    return pass;
+}
+
+void raytracer(const bool wavefront) {
+    const RtParams params = {
+            1024, 768, 8, 4,
+            v3(0, 0, 250.0f), v3zero(), v3up(),
+            90.0f * PI / 180.0f, 4.0f / 3.0f, 0, 1,
+            0.0f, wavefront };
+
+    ImageStream stream;
+    if (!imageStreamOpen(&stream, "out.ppm", params.width, params.height)) {
+        printf("Error opening file!\n");
+        exit(1);
+    }
+
+    vec4 *pixels = malloc(sizeof(vec4) * params.width * params.height);
+    if (pixels == NULL) {
+        printf("Not enough memory for %dx%d!\n", params.width, params.height);
+        exit(1);
+    }
+    const bool streamed = raytracerRender(&params, pixels, &stream, parallelThreads());
+
+    if (!imageStreamClose(&stream) || !streamed || !imageWritePfm("out.pfm", pixels, params.width, params.height)) {
+        printf("Error writing file!\n");
+        exit(1);
+    }
+    free(pixels);
+}
+
+static void raytracerPreviewPass(const int pass, const vec4 *estimate, const int active, void *context) {
+    const RtParams *params = context;
+    printf("pass: %d, active pixels: %d\n", pass, active);
+    if (!imageWritePpm("out.ppm", estimate, params->width, params->height)) {
+        printf("Error writing file!\n");
+        exit(1);
+    }
+}
+
+void raytracerPreview() {
+    const RtParams params = {
+            1024, 768, 1, 4,
+            v3(0, 0, 250.0f), v3zero(), v3up(),
+            90.0f * PI / 180.0f, 4.0f / 3.0f, 0, 1,
+            0.0f, false };
+
+    vec4 *pixels = malloc(sizeof(vec4) * params.width * params.height);
+    if (pixels == NULL || raytracerProgressive(&params, 64, 0.002f, pixels, raytracerPreviewPass, (void *) &params,
+                                               parallelThreads()) < 0) {
+        printf("Not enough memory for %dx%d!\n", params.width, params.height);
+        exit(1);
+    }
+    if (!imageWritePfm("out.pfm", pixels, params.width, params.height)) {
+        printf("Error writing file!\n");
+        exit(1);
+    }
+    free(pixels);
 }
 
 // endregion ------------------- RAYTRACING ---------------
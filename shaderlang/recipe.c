@@ -0,0 +1,350 @@
+//
+// Created by greg on 2021-08-26.
+//
+
+#include "lang.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// region ------------------- RECIPE ---------------
+
+// Host reader for the ShaderEd recipes: "label: expression" per line, "//" comments. An expression is
+// a reference to an earlier label, a number, a comma separated vector or an operation with its arguments,
+// brackets group the nested operations. Labels can be redefined, the last definition wins.
+
+#define RECIPE_ARGS 4
+
+typedef struct RecipeCursor {
+    const Recipe *recipe;
+    const char *at;
+} RecipeCursor;
+
+static void recipeSkipSpaces(RecipeCursor *cursor) {
+    while (*cursor->at == ' ' || *cursor->at == '\t') {
+        cursor->at++;
+    }
+}
+
+static bool recipeWord(RecipeCursor *cursor, char *word) {
+    int len = 0;
+    while (*cursor->at != '\0' && *cursor->at != '(' && *cursor->at != ')' && !isspace((unsigned char) *cursor->at)) {
+        if (len == RECIPE_NAME - 1) {
+            return false;
+        }
+        word[len++] = *cursor->at++;
+    }
+    word[len] = '\0';
+    return len > 0;
+}
+
+const RecipeValue *recipeFind(const Recipe *recipe, const char *name) {
+    for (int i = recipe->count - 1; i >= 0; i--) {
+        if (strcmp(recipe->values[i].name, name) == 0) {
+            return &recipe->values[i];
+        }
+    }
+    return NULL;
+}
+
+static bool recipeLiteral(const Recipe *recipe, const char *word, RecipeValue *value) {
+    const RecipeValue *found = recipeFind(recipe, word);
+    if (found != NULL) {
+        *value = *found;
+        return true;
+    }
+
+    char *end;
+    const long i = strtol(word, &end, 10);
+    if (end != word && *end == '\0') {
+        value->type = RECIPE_INT;
+        value->i = (int) i;
+        return true;
+    }
+
+    // floats take the Kotlin suffix, vectors are comma separated floats
+    float parts[4];
+    int count = 0;
+    const char *at = word;
+    while (count < 4) {
+        parts[count++] = strtof(at, &end);
+        if (end == at) {
+            return false;
+        }
+        if (*end == 'f') {
+            end++;
+        }
+        if (*end != ',') {
+            break;
+        }
+        at = end + 1;
+    }
+    if (*end != '\0') {
+        return false;
+    }
+    value->type = RECIPE_FLOAT + count - 1;
+    value->v = v4(parts[0], count > 1 ? parts[1] : 0.0f, count > 2 ? parts[2] : 0.0f, count > 3 ? parts[3] : 0.0f);
+    value->f = parts[0];
+    return true;
+}
+
+static bool recipeFloatArg(const RecipeValue *value, float *result) {
+    if (value->type == RECIPE_INT) {
+        *result = itof(value->i);
+        return true;
+    }
+    if (value->type == RECIPE_FLOAT) {
+        *result = value->f;
+        return true;
+    }
+    return false;
+}
+
+static bool recipeVec3Arg(const RecipeValue *value, vec3 *result) {
+    if (value->type != RECIPE_VEC3) {
+        return false;
+    }
+    *result = v4tov3(value->v);
+    return true;
+}
+
+static bool recipeMat4Arg(const RecipeValue *value, mat4 *result) {
+    if (value->type != RECIPE_MAT4) {
+        return false;
+    }
+    *result = value->m;
+    return true;
+}
+
+static RecipeValue recipeFloat(const float f) {
+    RecipeValue result;
+    result.type = RECIPE_FLOAT;
+    result.f = f;
+    return result;
+}
+
+static RecipeValue recipeVec(const int type, const vec4 v) {
+    RecipeValue result;
+    result.type = type;
+    result.v = v;
+    return result;
+}
+
+static RecipeValue recipeMat4(const mat4 m) {
+    RecipeValue result;
+    result.type = RECIPE_MAT4;
+    result.m = m;
+    return result;
+}
+
+// the operations the recipes use, evaluated with the C twins of the shader functions
+static bool recipeApply(const char *op, const RecipeValue *args, const int argc, RecipeValue *result) {
+    float f[RECIPE_ARGS];
+    int floats = 0;
+    while (floats < argc && recipeFloatArg(&args[floats], &f[floats])) {
+        floats++;
+    }
+    vec3 v;
+    mat4 left;
+    mat4 right;
+
+    if (strcmp(op, "v2") == 0 && argc == 2 && floats == 2) {
+        *result = recipeVec(RECIPE_VEC2, v4(f[0], f[1], 0.0f, 0.0f));
+    } else if (strcmp(op, "v3") == 0 && argc == 3 && floats == 3) {
+        *result = recipeVec(RECIPE_VEC3, v4(f[0], f[1], f[2], 0.0f));
+    } else if (strcmp(op, "v4") == 0 && argc == 4 && floats == 4) {
+        *result = recipeVec(RECIPE_VEC4, v4(f[0], f[1], f[2], f[3]));
+    } else if (strcmp(op, "addf") == 0 && argc == 2 && floats == 2) {
+        *result = recipeFloat(addf(f[0], f[1]));
+    } else if (strcmp(op, "subf") == 0 && argc == 2 && floats == 2) {
+        *result = recipeFloat(subf(f[0], f[1]));
+    } else if (strcmp(op, "mulf") == 0 && argc == 2 && floats == 2) {
+        *result = recipeFloat(mulf(f[0], f[1]));
+    } else if (strcmp(op, "divf") == 0 && argc == 2 && floats == 2) {
+        *result = recipeFloat(divf(f[0], f[1]));
+    } else if (strcmp(op, "minf") == 0 && argc == 2 && floats == 2) {
+        *result = recipeFloat(minf(f[0], f[1]));
+    } else if (strcmp(op, "maxf") == 0 && argc == 2 && floats == 2) {
+        *result = recipeFloat(maxf(f[0], f[1]));
+    } else if (strcmp(op, "powf") == 0 && argc == 2 && floats == 2) {
+        *result = recipeFloat(powf(f[0], f[1]));
+    } else if (strcmp(op, "sinf") == 0 && argc == 1 && floats == 1) {
+        *result = recipeFloat(sinf(f[0]));
+    } else if (strcmp(op, "cosf") == 0 && argc == 1 && floats == 1) {
+        *result = recipeFloat(cosf(f[0]));
+    } else if (strcmp(op, "tanf") == 0 && argc == 1 && floats == 1) {
+        *result = recipeFloat(tanf(f[0]));
+    } else if (strcmp(op, "sqrtf") == 0 && argc == 1 && floats == 1) {
+        *result = recipeFloat(sqrtf(f[0]));
+    } else if (strcmp(op, "absf") == 0 && argc == 1 && floats == 1) {
+        *result = recipeFloat(absf(f[0]));
+    } else if (strcmp(op, "m4ident") == 0 && argc == 0) {
+        *result = recipeMat4(m4ident());
+    } else if (strcmp(op, "translatem4") == 0 && argc == 1 && recipeVec3Arg(&args[0], &v)) {
+        *result = recipeMat4(translatem4(v));
+    } else if (strcmp(op, "scalem4") == 0 && argc == 1 && recipeVec3Arg(&args[0], &v)) {
+        *result = recipeMat4(scalem4(v));
+    } else if (strcmp(op, "rotatem4") == 0 && argc == 2 && recipeVec3Arg(&args[0], &v)
+            && recipeFloatArg(&args[1], &f[1])) {
+        *result = recipeMat4(rotatem4(v, f[1]));
+    } else if (strcmp(op, "mulm4") == 0 && argc == 2 && recipeMat4Arg(&args[0], &left)
+            && recipeMat4Arg(&args[1], &right)) {
+        *result = recipeMat4(mulm4(left, right));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// an operation with its arguments up to the closing bracket or the end of the line
+static bool recipeExpression(RecipeCursor *cursor, RecipeValue *result) {
+    char op[RECIPE_NAME];
+    RecipeValue args[RECIPE_ARGS];
+    int argc = 0;
+    recipeSkipSpaces(cursor);
+    if (*cursor->at == '(') {
+        cursor->at++;
+        if (!recipeExpression(cursor, result) || *cursor->at != ')') {
+            return false;
+        }
+        cursor->at++;
+        recipeSkipSpaces(cursor);
+        return *cursor->at == '\0' || *cursor->at == ')';
+    }
+    if (!recipeWord(cursor, op)) {
+        return false;
+    }
+    while (true) {
+        recipeSkipSpaces(cursor);
+        if (*cursor->at == '\0' || *cursor->at == ')') {
+            break;
+        }
+        if (argc == RECIPE_ARGS) {
+            return false;
+        }
+        if (*cursor->at == '(') {
+            cursor->at++;
+            if (!recipeExpression(cursor, &args[argc]) || *cursor->at != ')') {
+                return false;
+            }
+            cursor->at++;
+        } else {
+            char word[RECIPE_NAME];
+            if (!recipeWord(cursor, word) || !recipeLiteral(cursor->recipe, word, &args[argc])) {
+                return false;
+            }
+        }
+        argc++;
+    }
+    if (argc == 0 && recipeLiteral(cursor->recipe, op, result)) {
+        return true;
+    }
+    return recipeApply(op, args, argc, result);
+}
+
+// reports nothing itself: on failure the caller finds the offending line in errorLine
+bool recipeParse(Recipe *recipe, const char *text) {
+    recipe->count = 0;
+    recipe->errorLine = 0;
+    int lineNo = 0;
+    const char *line = text;
+    while (*line != '\0') {
+        lineNo++;
+        const char *next = strchr(line, '\n');
+        const size_t len = next != NULL ? (size_t) (next - line) : strlen(line);
+        if (len >= RECIPE_LINE) {
+            recipe->errorLine = lineNo;
+            return false;
+        }
+        char buffer[RECIPE_LINE];
+        memcpy(buffer, line, len);
+        line = next != NULL ? next + 1 : line + len;
+        buffer[len] = '\0';
+        char *end = buffer + len;
+        while (end > buffer && isspace((unsigned char) end[-1])) {
+            *--end = '\0';
+        }
+
+        RecipeCursor cursor = { recipe, buffer };
+        recipeSkipSpaces(&cursor);
+        if (*cursor.at == '\0' || strncmp(cursor.at, "//", 2) == 0) {
+            continue;
+        }
+        char label[RECIPE_NAME];
+        char *separator = strchr(buffer, ':');
+        bool parsed = separator != NULL && recipe->count < RECIPE_VALUES;
+        if (parsed) {
+            *separator = '\0';
+            parsed = recipeWord(&cursor, label);
+            recipeSkipSpaces(&cursor);
+            parsed = parsed && *cursor.at == '\0';
+        }
+        RecipeValue value;
+        if (parsed) {
+            cursor.at = separator + 1;
+            parsed = recipeExpression(&cursor, &value) && *cursor.at == '\0';
+        }
+        if (!parsed) {
+            recipe->errorLine = lineNo;
+            return false;
+        }
+        strcpy(value.name, label);
+        recipe->values[recipe->count] = value;
+        recipe->count++;
+    }
+    return true;
+}
+
+bool recipeLoad(Recipe *recipe, const char *path) {
+    recipe->errorLine = 0;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = size >= 0 ? malloc(size + 1) : NULL;
+    if (text == NULL) {
+        fclose(f);
+        return false;
+    }
+    const bool read = fread(text, 1, size, f) == (size_t) size;
+    fclose(f);
+    text[read ? size : 0] = '\0';
+    const bool result = read && recipeParse(recipe, text);
+    free(text);
+    return result;
+}
+
+bool recipeGetFloat(const Recipe *recipe, const char *name, float *result) {
+    const RecipeValue *value = recipeFind(recipe, name);
+    return value != NULL && recipeFloatArg(value, result);
+}
+
+bool recipeGetInt(const Recipe *recipe, const char *name, int *result) {
+    const RecipeValue *value = recipeFind(recipe, name);
+    if (value == NULL || value->type != RECIPE_INT) {
+        return false;
+    }
+    *result = value->i;
+    return true;
+}
+
+bool recipeGetVec(const Recipe *recipe, const char *name, const int type, vec4 *result) {
+    const RecipeValue *value = recipeFind(recipe, name);
+    if (value == NULL || value->type != type) {
+        return false;
+    }
+    *result = value->v;
+    return true;
+}
+
+bool recipeGetMat4(const Recipe *recipe, const char *name, mat4 *result) {
+    const RecipeValue *value = recipeFind(recipe, name);
+    return value != NULL && recipeMat4Arg(value, result);
+}
+
+// endregion ------------------- RECIPE ---------------
@@ -4,9 +4,39 @@
 
 #include "lang.h"
 
+#include <stddef.h>
+
+typedef struct SamplerTexture {
+    int width;
+    int height;
+    int channels;
+    const unsigned char *texels;
+} SamplerTexture;
+
+static SamplerTexture samplerTextures[SAMPLER_HOST];
+
+// binds before the passes run, the threads only read the table
+void samplerBind(const sampler2D sampler, const int width, const int height, const int channels,
+                 const unsigned char *texels) {
+    const SamplerTexture texture = { width, height, channels, texels };
+    samplerTextures[sampler.handle] = texture;
+}
+
+// nearest texel, clamped to the edge; zero for the unbound handles
 custom
 vec4 sampler(const sampler2D sampler, const vec2 texCoords) {
-    return v4zero();
+    if (sampler.handle < 0 || sampler.handle >= SAMPLER_HOST || samplerTextures[sampler.handle].texels == NULL) {
+        return v4zero();
+    }
+    const SamplerTexture *texture = &samplerTextures[sampler.handle];
+    const int x = ftoi(clampf(floorf(texCoords.x * itof(texture->width)), 0.0f, itof(texture->width - 1)));
+    const int y = ftoi(clampf(floorf(texCoords.y * itof(texture->height)), 0.0f, itof(texture->height - 1)));
+    const unsigned char *texel = &texture->texels[(y * texture->width + x) * texture->channels];
+    float channels[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < texture->channels && i < 4; i++) {
+        channels[i] = itof(texel[i]);
+    }
+    return v4(channels[0], channels[1], channels[2], channels[3]);
 }
 
 custom
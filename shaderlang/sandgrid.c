@@ -0,0 +1,290 @@
+//
+// Created by greg on 2021-08-27.
+//
+
+#include "lang.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// region ------------------- SANDGRID ---------------
+
+// The sandsim passes on the CPU: the same sandPhysics, sandSolver and sandDraw as on the GPU,
+// sampling the byte grids through the host samplers.
+//
+// The passes only visit the chunks with a change in their 3x3 chunk neighbourhood during the last
+// two steps, one step for each Margolus offset. A cell depends on the cells two away at most, so
+// everywhere else the grid is a fixed point of both steps: the next buffer already holds the same
+// cells from the step before and the deltas are the ones the physics would write again.
+
+#define SAND_ORIG 0
+#define SAND_DELTAS 1
+#define SAND_ROWS 16
+
+#define SAND_CHANGED_NOW 4
+#define SAND_CHANGED_LAST 1
+#define SAND_CHANGED_BEFORE 2
+
+typedef struct SandChunks {
+    SandGrid *grid;
+    TileFunc pass;
+    bool track;
+} SandChunks;
+
+typedef struct SandDraw {
+    const SandGrid *grid;
+    vec4 *pixels;
+} SandDraw;
+
+static vec2 sandGridUV(const int x, const int y, const ivec2 wh) {
+    return v2((itof(x) + 0.5f) / itof(wh.x), (itof(y) + 0.5f) / itof(wh.y));
+}
+
+bool sandGridCreate(SandGrid *grid, const int width, const int height) {
+    const size_t count = (size_t) width * height;
+    grid->width = width;
+    grid->height = height;
+    grid->mode = SAND_STEP_SOLVER;
+    grid->frame = 0;
+    grid->chunksX = (width + SAND_CHUNK - 1) / SAND_CHUNK;
+    grid->chunksY = (height + SAND_CHUNK - 1) / SAND_CHUNK;
+    grid->activeCnt = 0;
+    grid->cells = calloc(count, 1);
+    grid->next = calloc(count, 1);
+    grid->deltas = calloc(count, 1);
+    grid->changes = calloc((size_t) grid->chunksX * grid->chunksY, 1);
+    grid->active = calloc((size_t) grid->chunksX * grid->chunksY, sizeof(int));
+    if (grid->cells == NULL || grid->next == NULL || grid->deltas == NULL || grid->changes == NULL
+            || grid->active == NULL) {
+        sandGridFree(grid);
+        return false;
+    }
+    sandGridWake(grid);
+    return true;
+}
+
+void sandGridFree(SandGrid *grid) {
+    free(grid->cells);
+    free(grid->next);
+    free(grid->deltas);
+    free(grid->changes);
+    free(grid->active);
+    grid->cells = NULL;
+    grid->next = NULL;
+    grid->deltas = NULL;
+    grid->changes = NULL;
+    grid->active = NULL;
+}
+
+// after the cells were changed from the outside: every chunk runs for the next two steps
+void sandGridWake(SandGrid *grid) {
+    memset(grid->changes, SAND_CHANGED_LAST | SAND_CHANGED_BEFORE, (size_t) grid->chunksX * grid->chunksY);
+}
+
+static void sandGridActivate(SandGrid *grid) {
+    grid->activeCnt = 0;
+    for (int cy = 0; cy < grid->chunksY; cy++) {
+        for (int cx = 0; cx < grid->chunksX; cx++) {
+            bool changed = false;
+            for (int y = cy - 1; y <= cy + 1 && !changed; y++) {
+                for (int x = cx - 1; x <= cx + 1 && !changed; x++) {
+                    changed = x >= 0 && y >= 0 && x < grid->chunksX && y < grid->chunksY
+                            && grid->changes[y * grid->chunksX + x] != 0;
+                }
+            }
+            if (changed) {
+                grid->active[grid->activeCnt++] = cy * grid->chunksX + cx;
+            }
+        }
+    }
+}
+
+// the start image through sandConvert, row 0 at the bottom
+void sandGridConvert(SandGrid *grid, const vec4 *pixels) {
+    const int count = grid->width * grid->height;
+    for (int i = 0; i < count; i++) {
+        grid->cells[i] = (unsigned char) ftoi(sandConvert(pixels[i]).x);
+    }
+    sandGridWake(grid);
+}
+
+// a sandbox to benchmark on: the upper half scattered with water, sand above it
+void sandGridScatter(SandGrid *grid, const float density) {
+    for (int y = grid->height / 2; y < grid->height; y++) {
+        for (int x = 0; x < grid->width; x++) {
+            const float rnd = rndf(itof(y * grid->width + x));
+            if (rnd < density) {
+                const int seed = ftoi(rnd / density * 4.0f) % 4;
+                const int type = y < grid->height * 3 / 4 ? TYPE_WATER : TYPE_SAND;
+                grid->cells[y * grid->width + x] = (unsigned char) sandPack(type, iv2zero(), seed);
+            }
+        }
+    }
+    sandGridWake(grid);
+}
+
+static void sandPhysicsRows(const int x0, const int y0, const int x1, const int y1, void *context) {
+    SandGrid *grid = context;
+    const sampler2D orig = { SAND_ORIG };
+    const ivec2 wh = iv2(grid->width, grid->height);
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            grid->deltas[y * grid->width + x] = (unsigned char) ftoi(sandPhysics(orig, sandGridUV(x, y, wh), wh, grid->frame).x);
+        }
+    }
+}
+
+static void sandSolverRows(const int x0, const int y0, const int x1, const int y1, void *context) {
+    SandGrid *grid = context;
+    const sampler2D orig = { SAND_ORIG };
+    const sampler2D deltas = { SAND_DELTAS };
+    const ivec2 wh = iv2(grid->width, grid->height);
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            grid->next[y * grid->width + x] = (unsigned char) ftoi(sandSolver(orig, deltas, sandGridUV(x, y, wh), wh).x);
+        }
+    }
+}
+
+static void sandMargolusRows(const int x0, const int y0, const int x1, const int y1, void *context) {
+    SandGrid *grid = context;
+    const sampler2D orig = { SAND_ORIG };
+    const ivec2 wh = iv2(grid->width, grid->height);
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            const vec4 cell = sandMargolus(orig, sandGridUV(x, y, wh), wh, grid->frame);
+            grid->next[y * grid->width + x] = (unsigned char) ftoi(cell.x);
+        }
+    }
+}
+
+static void sandDrawRows(const int x0, const int y0, const int x1, const int y1, void *context) {
+    const SandDraw *draw = context;
+    const sampler2D orig = { SAND_ORIG };
+    const ivec2 wh = iv2(draw->grid->width, draw->grid->height);
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            draw->pixels[y * wh.x + x] = sandDraw(orig, sandGridUV(x, y, wh), wh);
+        }
+    }
+}
+
+// runs a pass over the active chunks, one chunk per tile, and marks the chunks it changed
+static void sandChunksTile(const int x0, const int y0, const int x1, const int y1, void *context) {
+    const SandChunks *chunks = context;
+    SandGrid *grid = chunks->grid;
+    for (int i = x0; i < x1; i++) {
+        const int chunk = grid->active[i];
+        const int cx0 = (chunk % grid->chunksX) * SAND_CHUNK;
+        const int cy0 = (chunk / grid->chunksX) * SAND_CHUNK;
+        const int cx1 = cx0 + SAND_CHUNK < grid->width ? cx0 + SAND_CHUNK : grid->width;
+        const int cy1 = cy0 + SAND_CHUNK < grid->height ? cy0 + SAND_CHUNK : grid->height;
+        chunks->pass(cx0, cy0, cx1, cy1, grid);
+        if (!chunks->track) {
+            continue;
+        }
+        for (int y = cy0; y < cy1; y++) {
+            const int row = y * grid->width;
+            if (memcmp(&grid->cells[row + cx0], &grid->next[row + cx0], cx1 - cx0) != 0) {
+                grid->changes[chunk] |= SAND_CHANGED_NOW;
+                break;
+            }
+        }
+    }
+    (void) y0;
+    (void) y1;
+}
+
+static void sandGridChunks(SandGrid *grid, const TileFunc pass, const bool track, const int threadsCnt) {
+    sandGridActivate(grid);
+    SandChunks chunks = { grid, pass, track };
+    parallelTiles(grid->activeCnt, 1, 1, 1, threadsCnt, sandChunksTile, &chunks);
+}
+
+// the moves of the cells into the deltas
+void sandGridPhysics(SandGrid *grid, const int threadsCnt) {
+    const sampler2D orig = { SAND_ORIG };
+    samplerBind(orig, grid->width, grid->height, 1, grid->cells);
+    sandGridChunks(grid, sandPhysicsRows, false, threadsCnt);
+}
+
+// the cells after the moves into the next buffer
+void sandGridSolve(SandGrid *grid, const int threadsCnt) {
+    const sampler2D orig = { SAND_ORIG };
+    const sampler2D deltas = { SAND_DELTAS };
+    samplerBind(orig, grid->width, grid->height, 1, grid->cells);
+    samplerBind(deltas, grid->width, grid->height, 1, grid->deltas);
+    sandGridChunks(grid, sandSolverRows, true, threadsCnt);
+}
+
+// the cells after their blocks moved into the next buffer, no deltas in between
+void sandGridMargolus(SandGrid *grid, const int threadsCnt) {
+    const sampler2D orig = { SAND_ORIG };
+    samplerBind(orig, grid->width, grid->height, 1, grid->cells);
+    sandGridChunks(grid, sandMargolusRows, true, threadsCnt);
+}
+
+void sandGridStep(SandGrid *grid, const int threadsCnt) {
+    if (grid->mode == SAND_STEP_MARGOLUS) {
+        sandGridMargolus(grid, threadsCnt);
+    } else {
+        sandGridPhysics(grid, threadsCnt);
+        sandGridSolve(grid, threadsCnt);
+    }
+    grid->frame++;
+    unsigned char *swap = grid->cells;
+    grid->cells = grid->next;
+    grid->next = swap;
+
+    const int chunksCnt = grid->chunksX * grid->chunksY;
+    for (int i = 0; i < chunksCnt; i++) {
+        const unsigned char changes = grid->changes[i];
+        grid->changes[i] = (unsigned char) (((changes & SAND_CHANGED_LAST) != 0 ? SAND_CHANGED_BEFORE : 0)
+                | ((changes & SAND_CHANGED_NOW) != 0 ? SAND_CHANGED_LAST : 0));
+    }
+}
+
+void sandGridDraw(const SandGrid *grid, vec4 *pixels, const int threadsCnt) {
+    const sampler2D orig = { SAND_ORIG };
+    samplerBind(orig, grid->width, grid->height, 1, grid->cells);
+    SandDraw draw = { grid, pixels };
+    parallelTiles(grid->width, grid->height, grid->width, SAND_ROWS, threadsCnt, sandDrawRows, &draw);
+}
+
+// Headless: the scattered sandbox simulated for a number of steps. Prints the cells per second and
+// writes the last frame into out.ppm.
+void sandGridRun(const int width, const int height, const int steps, const int mode) {
+    SandGrid grid;
+    vec4 *pixels = malloc(sizeof(vec4) * width * height);
+    if (pixels == NULL || !sandGridCreate(&grid, width, height)) {
+        printf("Not enough memory for %dx%d!\n", width, height);
+        exit(1);
+    }
+    grid.mode = mode;
+    sandGridScatter(&grid, 0.3f);
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < steps; i++) {
+        sandGridStep(&grid, parallelThreads());
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) * 1e-9;
+    const double cells = (double) width * height * steps;
+    printf("sandsim: %dx%d, %d %s steps in %.3fs, %.1f Mcells/s, %d of %d chunks active at the end\n",
+           width, height, steps, mode == SAND_STEP_MARGOLUS ? "margolus" : "solver", seconds,
+           cells / (seconds > 0.0 ? seconds : 1.0) * 1e-6, grid.activeCnt, grid.chunksX * grid.chunksY);
+
+    sandGridDraw(&grid, pixels, parallelThreads());
+    if (!imageWritePpm("out.ppm", pixels, width, height)) {
+        printf("Error writing file!\n");
+        exit(1);
+    }
+    sandGridFree(&grid);
+    free(pixels);
+}
+
+// endregion ------------------- SANDGRID ---------------
@@ -13,17 +13,64 @@ const int TYPE_SAND     = 1;
 public
 const int TYPE_WATER    = 2;
 
+public
+const int TYPE_WALL     = 3;
+
+// A cell is one integer in one channel, exact in a byte and in a half float texel: the type in the
+// lowest two bits, the move of the last step in the next four and a colour seed in the top two.
+// Kept to arithmetic, the shaders have no bit operators. Zero is an empty cell, a resting cell
+// without a seed is its type.
+public
+int sandPack(const int type, const ivec2 move, const int seed) {
+    const int dir = (move.x + 3) % 3 + ((move.y + 3) % 3) * 3;
+    return type + dir * 4 + seed * 64;
+}
+
+public
+int sandType(const int cell) {
+    return cell % 4;
+}
+
+// -1, 0, 1 along both axes, stored as 2, 0, 1
+public
+ivec2 sandMove(const int cell) {
+    const int dir = (cell / 4) % 16;
+    const int x = dir % 3;
+    const int y = dir / 3;
+    return iv2(x == 2 ? -1 : x, y == 2 ? -1 : y);
+}
+
+public
+int sandSeed(const int cell) {
+    return cell / 64;
+}
+
+public
+int sandCellAt(const sampler2D orig, const vec2 uv) {
+    return ftoi(sampler(orig, uv).x);
+}
+
+// the seed from the lowest bits of the blue byte, a textured start image gives grains of every shade
 public
 vec4 sandConvert(const vec4 pixel) {
+    const int seed = ftoi(pixel.z * 255.0f) % 4;
     if (pixel.x > 0.9f && pixel.y > 0.9f) {
-        return v4(itof(TYPE_SAND), 0.0f, 0.0f, pixel.x);
+        return v4(itof(sandPack(TYPE_SAND, iv2zero(), seed)), 0.0f, 0.0f, 0.0f);
     } if (pixel.z > 0.9f) {
-        return v4(itof(TYPE_WATER), 0.0f, 0.0f, pixel.x);
+        return v4(itof(sandPack(TYPE_WATER, iv2zero(), seed)), 0.0f, 0.0f, 0.0f);
     } else {
         return v4zero();
     }
 }
 
+// One hash of the integer cell, the frame and the material, nothing carried between the calls: any
+// thread can step any cell and a replay is bit exact. The frame keeps a cell from choosing the
+// same side forever.
+public
+float sandRnd(const ivec2 cell, const int frame, const int material) {
+    return rndv3(v3(itof(cell.x), itof(cell.y), itof(frame * 4 + material)));
+}
+
 protected
 vec2 nearbyCellCoords(const vec2 uv, const float cellW, const float cellH, const int x, const int y) {
     return v2(uv.x + itof(x) * cellW, uv.y + itof(y) * cellH);
@@ -37,21 +84,20 @@ ivec2 tryDepositParticle(const sampler2D orig, const vec2 uv,
     if (coords.x < 0.0f || coords.y < 0.0f || coords.x > 1.0f || coords.y > 1.0f) {
         return iv2zero();
     }
-    const vec4 cell = sampler(orig, coords);
-    if (ftoi(cell.x) == TYPE_EMPTY) {
+    if (sandType(sandCellAt(orig, coords)) == TYPE_EMPTY) {
         return iv2(x, y);
     }
     return iv2zero();
 }
 
 protected
-ivec2 simTypeSand(const sampler2D orig, const vec2 uv, const float cellW, const float cellH) {
+ivec2 simTypeSand(const sampler2D orig, const vec2 uv, const float cellW, const float cellH, const float rnd) {
     ivec2 deposit = tryDepositParticle(orig, uv, cellW, cellH, 0, -1);
     if (!eqiv2(deposit, iv2zero())) {
         return deposit;
     }
 
-    const bool left = rndv2(uv) > 0.5f;
+    const bool left = rnd > 0.5f;
     const int first =  left ? -1 :  1;
     const int second = left ?  1 : -1;
 
@@ -69,13 +115,14 @@ ivec2 simTypeSand(const sampler2D orig, const vec2 uv, const float cellW, const
 }
 
 protected
-ivec2 simTypeWater(const sampler2D orig, const vec2 uv, const float cellW, const float cellH) {
-    ivec2 deposit = simTypeSand(orig, uv, cellW, cellH);
+ivec2 simTypeWater(const sampler2D orig, const vec2 uv, const float cellW, const float cellH, const float rnd) {
+    ivec2 deposit = simTypeSand(orig, uv, cellW, cellH, rnd);
     if (!eqiv2(deposit, iv2zero())) {
         return deposit;
     }
 
-    const bool left = rndv3(v2tov3(uv, itof(TYPE_WATER))) > 0.5f;
+    // the middle half against the upper half: independent of the slope side, the same hash
+    const bool left = rnd > 0.25f && rnd < 0.75f;
     const int first =  left ? -1 :  1;
     const int second = left ?  1 : -1;
 
@@ -92,16 +139,19 @@ ivec2 simTypeWater(const sampler2D orig, const vec2 uv, const float cellW, const
     return iv2zero();
 }
 
+// the move each cell wants into the direction nibble of its own texel, one channel for the deltas
 public
-vec4 sandPhysics(const sampler2D orig, const vec2 uv, const ivec2 wh) {
+vec4 sandPhysics(const sampler2D orig, const vec2 uv, const ivec2 wh, const int frame) {
     const float cellW = 1.0f / itof(wh.x);
     const float cellH = 1.0f / itof(wh.y);
 
-    const int type = ftoi(sampler(orig, uv).x);
+    const int cell = sandCellAt(orig, uv);
+    const int type = sandType(cell);
+    const float rnd = sandRnd(iv2(ftoi(uv.x * itof(wh.x)), ftoi(uv.y * itof(wh.y))), frame, type);
     if (type == TYPE_SAND) {
-        return iv2tov4(simTypeSand(orig, uv, cellW, cellH), 0.0f, 0.0f);
+        return v4(itof(sandPack(type, simTypeSand(orig, uv, cellW, cellH, rnd), sandSeed(cell))), 0.0f, 0.0f, 0.0f);
     } if (type == TYPE_WATER) {
-        return iv2tov4(simTypeWater(orig, uv, cellW, cellH), 0.0f, 0.0f);
+        return v4(itof(sandPack(type, simTypeWater(orig, uv, cellW, cellH, rnd), sandSeed(cell))), 0.0f, 0.0f, 0.0f);
     } else {
         return v4zero();
     }
@@ -119,19 +169,95 @@ vec4 sandSolver(const sampler2D orig, const sampler2D deltas, const vec2 uv, con
             if (coords.x < 0.0f || coords.y < 0.0f || coords.x > 1.0f || coords.y > 1.0f) {
                 continue;
             }
-            const vec4 cell = sampler(orig, coords);
-            if (ftoi(cell.x) == TYPE_EMPTY) {
+            if (sandType(sandCellAt(orig, coords)) == TYPE_EMPTY) {
                 continue;
             }
-            const vec4 delta = sampler(deltas, coords);
-            if (delta.x == itof(-x) && delta.y == itof(-y)) {
-                return cell;
+            const int delta = sandCellAt(deltas, coords);
+            const ivec2 move = sandMove(delta);
+            if (move.x == -x && move.y == -y) {
+                return v4(itof(delta), 0.0f, 0.0f, 0.0f);
             }
         }
     }
     return result;
 }
 
+// outside of the grid is a wall, nothing moves in or out
+protected
+int sandBlockCell(const sampler2D orig, const int x, const int y, const ivec2 wh) {
+    if (x < 0 || y < 0 || x >= wh.x || y >= wh.y) {
+        return TYPE_WALL;
+    }
+    return sandCellAt(orig, v2((itof(x) + 0.5f) / itof(wh.x), (itof(y) + 0.5f) / itof(wh.y)));
+}
+
+protected
+bool sandBlockMovable(const int cell) {
+    return sandType(cell) == TYPE_SAND || sandType(cell) == TYPE_WATER;
+}
+
+// The Margolus neighbourhood: the grid is split into 2x2 blocks, shifted by one cell on odd frames,
+// and every block moves its own particles within itself - 4 fetches per cell, one pass, nothing to
+// gather and no two particles can take the same cell. Every cell of a block resolves the whole block
+// the same way and keeps its own quarter: cells 0, 1 are the bottom left and right, 2, 3 the top.
+public
+vec4 sandMargolus(const sampler2D orig, const vec2 uv, const ivec2 wh, const int frame) {
+    const int offset = frame % 2;
+    const int x = ftoi(uv.x * itof(wh.x));
+    const int y = ftoi(uv.y * itof(wh.y));
+    const int bx = ((x + offset) / 2) * 2 - offset;
+    const int by = ((y + offset) / 2) * 2 - offset;
+
+    int cells[4];
+    int from[4];
+    for (int i = 0; i < 4; i++) {
+        cells[i] = sandBlockCell(orig, bx + i % 2, by + i / 2, wh);
+        from[i] = i;
+    }
+
+    // straight down
+    for (int column = 0; column < 2; column++) {
+        if (sandBlockMovable(cells[column + 2]) && sandType(cells[column]) == TYPE_EMPTY) {
+            cells[column] = cells[column + 2];
+            from[column] = from[column + 2];
+            cells[column + 2] = TYPE_EMPTY;
+        }
+    }
+
+    // down the slope, the side to try first is the same for the whole block
+    const bool left = sandRnd(iv2(bx, by), frame, TYPE_EMPTY) > 0.5f;
+    for (int i = 0; i < 2; i++) {
+        const int top = (i == 0) == left ? 3 : 2;
+        const int to = top == 3 ? 0 : 1;
+        if (sandBlockMovable(cells[top]) && sandType(cells[top - 2]) != TYPE_EMPTY
+                && sandType(cells[to]) == TYPE_EMPTY) {
+            cells[to] = cells[top];
+            from[to] = from[top];
+            cells[top] = TYPE_EMPTY;
+        }
+    }
+
+    // water resting on something flows aside along the top row
+    for (int top = 2; top < 4; top++) {
+        const int to = top == 2 ? 3 : 2;
+        if (sandType(cells[top]) == TYPE_WATER && sandType(cells[top - 2]) != TYPE_EMPTY
+                && sandType(cells[to]) == TYPE_EMPTY) {
+            cells[to] = cells[top];
+            from[to] = from[top];
+            cells[top] = TYPE_EMPTY;
+            break;
+        }
+    }
+
+    const int own = (y - by) * 2 + (x - bx);
+    const int cell = cells[own];
+    if (sandType(cell) == TYPE_EMPTY) {
+        return v4zero();
+    }
+    const ivec2 move = iv2(own % 2 - from[own] % 2, own / 2 - from[own] / 2);
+    return v4(itof(sandPack(sandType(cell), move, sandSeed(cell))), 0.0f, 0.0f, 0.0f);
+}
+
 public
 vec4 sandDraw(const sampler2D orig, const vec2 uv, const ivec2 wh) {
     const float cellW = 1.0f / itof(wh.x);
@@ -142,11 +268,12 @@ vec4 sandDraw(const sampler2D orig, const vec2 uv, const ivec2 wh) {
     for (int x = -1; x < 2; x++) {
         for (int y = -1; y < 2; y++) {
             const vec2 coords = nearbyCellCoords(uv, cellW, cellH, x, y);
-            const vec4 cell = sampler(orig, coords);
+            const int cell = sandCellAt(orig, coords);
 
-            const int type = ftoi(cell.x);
+            // the seed darkens the grains a little, the sand does not look like a flat fill
+            const int type = sandType(cell);
             if (type == TYPE_SAND) {
-                result = addv3(result, v3yellow());
+                result = addv3(result, mulv3f(v3yellow(), 1.0f - itof(sandSeed(cell)) * 0.08f));
             } if (type == TYPE_WATER) {
                 result = addv3(result, v3blue());
             } else {
@@ -0,0 +1,219 @@
+//
+// Created by greg on 2021-08-25.
+//
+
+#include "lang.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// region ------------------- SDF CACHE ---------------
+
+// Static SDF programs baked into a distance grid: marching steps through trilinear lookups and
+// switches to the exact sceneDist only within one cell diagonal of the surface.
+
+#define SDF_CACHE_MAGIC "SDFC"
+#define SDF_CACHE_VERSION 1
+
+typedef struct SdfCacheHeader {
+    char magic[4];
+    int version;
+    long key;
+    int resX;
+    int resY;
+    int resZ;
+    float min[3];
+    float cell;
+} SdfCacheHeader;
+
+// the program travels with the bake, uSdfPrims and uSdfOps are per thread
+typedef struct SdfCacheBake {
+    SdfCache *cache;
+    SdfProgram program;
+} SdfCacheBake;
+
+static long sdfCacheHash(long hash, const void *data, const size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (long) (((unsigned long) hash ^ bytes[i]) * 1099511628211UL);
+    }
+    return hash;
+}
+
+long sdfCacheKey() {
+    // field by field - struct padding is not part of the program
+    long hash = (long) 14695981039346656037UL;
+    for (int i = 0; i < uSdfOpsCnt; i++) {
+        hash = sdfCacheHash(hash, &uSdfOps[i].op, sizeof(int));
+        if (uSdfOps[i].op == SDF_OP_PRIM) {
+            const SdfPrim *prim = &uSdfPrims[uSdfOps[i].index];
+            hash = sdfCacheHash(hash, &prim->type, sizeof(int));
+            hash = sdfCacheHash(hash, &prim->params.x, sizeof(float) * 4);
+            hash = sdfCacheHash(hash, prim->transform.value, sizeof(prim->transform.value));
+            hash = sdfCacheHash(hash, &prim->repeat.x, sizeof(float) * 4);
+            hash = sdfCacheHash(hash, &prim->limit.x, sizeof(float) * 4);
+            hash = sdfCacheHash(hash, &prim->displace.x, sizeof(float) * 2);
+        } else {
+            hash = sdfCacheHash(hash, &uSdfOps[i].blend, sizeof(float));
+        }
+    }
+    return hash;
+}
+
+static void sdfCacheTile(const int y0, const int z0, const int y1, const int z1, void *context) {
+    const SdfCacheBake *bake = context;
+    sdfProgramLoad(&bake->program);
+
+    SdfCache *cache = bake->cache;
+    for (int z = z0; z < z1; z++) {
+        for (int y = y0; y < y1; y++) {
+            float *row = &cache->dist[((long) z * cache->resY + y) * cache->resX];
+            for (int x = 0; x < cache->resX; x++) {
+                row[x] = sceneDist(addv3(cache->min, mulv3f(v3(itof(x), itof(y), itof(z)), cache->cell)));
+            }
+        }
+    }
+}
+
+bool sdfCacheBake(SdfCache *cache, const vec3 min, const vec3 max, const float cell, const int threadsCnt) {
+    cache->min = min;
+    cache->cell = cell;
+    cache->resX = (int) ceilf((max.x - min.x) / cell) + 1;
+    cache->resY = (int) ceilf((max.y - min.y) / cell) + 1;
+    cache->resZ = (int) ceilf((max.z - min.z) / cell) + 1;
+    cache->key = sdfCacheKey();
+    cache->dist = malloc(sizeof(float) * cache->resX * cache->resY * cache->resZ);
+    if (cache->dist == NULL) {
+        return false;
+    }
+
+    SdfCacheBake *bake = malloc(sizeof(SdfCacheBake));
+    if (bake == NULL) {
+        sdfCacheFree(cache);
+        return false;
+    }
+    bake->cache = cache;
+    sdfProgramSave(&bake->program);
+    parallelTiles(cache->resY, cache->resZ, 4, 4, threadsCnt, sdfCacheTile, bake);
+    free(bake);
+    return true;
+}
+
+void sdfCacheFree(SdfCache *cache) {
+    free(cache->dist);
+    cache->dist = NULL;
+}
+
+bool sdfCacheSave(const SdfCache *cache, const char *path) {
+    SdfCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SDF_CACHE_MAGIC, 4);
+    header.version = SDF_CACHE_VERSION;
+    header.key = cache->key;
+    header.resX = cache->resX;
+    header.resY = cache->resY;
+    header.resZ = cache->resZ;
+    header.min[0] = cache->min.x;
+    header.min[1] = cache->min.y;
+    header.min[2] = cache->min.z;
+    header.cell = cache->cell;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    const size_t count = (size_t) cache->resX * cache->resY * cache->resZ;
+    const bool result = fwrite(&header, sizeof(header), 1, f) == 1
+            && fwrite(cache->dist, sizeof(float), count, f) == count;
+    return fclose(f) == 0 && result;
+}
+
+// fails when the file is missing, damaged or baked from another program than the loaded one
+bool sdfCacheLoad(SdfCache *cache, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    SdfCacheHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1
+            || memcmp(header.magic, SDF_CACHE_MAGIC, 4) != 0 || header.version != SDF_CACHE_VERSION
+            || header.key != sdfCacheKey() || header.resX <= 0 || header.resY <= 0 || header.resZ <= 0) {
+        fclose(f);
+        return false;
+    }
+    const size_t count = (size_t) header.resX * header.resY * header.resZ;
+    float *dist = malloc(sizeof(float) * count);
+    if (dist == NULL || fread(dist, sizeof(float), count, f) != count) {
+        free(dist);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+
+    cache->min = v3(header.min[0], header.min[1], header.min[2]);
+    cache->cell = header.cell;
+    cache->resX = header.resX;
+    cache->resY = header.resY;
+    cache->resZ = header.resZ;
+    cache->key = header.key;
+    cache->dist = dist;
+    return true;
+}
+
+static float sdfCacheLerp(const float from, const float to, const float t) {
+    return from + (to - from) * t;
+}
+
+static bool sdfCacheSample(const SdfCache *cache, const vec3 p, float *dist) {
+    const vec3 g = divv3f(subv3(p, cache->min), cache->cell);
+    if (!(g.x >= 0.0f && g.y >= 0.0f && g.z >= 0.0f)) {
+        return false;
+    }
+    const int x = ftoi(g.x);
+    const int y = ftoi(g.y);
+    const int z = ftoi(g.z);
+    if (x >= cache->resX - 1 || y >= cache->resY - 1 || z >= cache->resZ - 1) {
+        return false;
+    }
+    const float fx = g.x - itof(x);
+    const float fy = g.y - itof(y);
+    const float fz = g.z - itof(z);
+    const long strideY = cache->resX;
+    const long strideZ = (long) cache->resX * cache->resY;
+    const float *c = &cache->dist[z * strideZ + y * strideY + x];
+    const float c00 = sdfCacheLerp(c[0], c[1], fx);
+    const float c10 = sdfCacheLerp(c[strideY], c[strideY + 1], fx);
+    const float c01 = sdfCacheLerp(c[strideZ], c[strideZ + 1], fx);
+    const float c11 = sdfCacheLerp(c[strideZ + strideY], c[strideZ + strideY + 1], fx);
+    *dist = sdfCacheLerp(sdfCacheLerp(c00, c10, fy), sdfCacheLerp(c01, c11, fy), fz);
+    return true;
+}
+
+// exact outside of the grid
+float sdfCacheDist(const SdfCache *cache, const vec3 p) {
+    float dist;
+    return sdfCacheSample(cache, p, &dist) ? dist : sceneDist(p);
+}
+
+// same as rayMarch, the interpolated distance is off by at most a cell diagonal
+float rayMarchCache(const SdfCache *cache, const vec3 ro, const vec3 rd) {
+    const float margin = cache->cell * sqrtf(3.0f);
+    float dO = 0.0f;
+    for (int i = 0; i < MAX_STEPS; i++) {
+        const vec3 p = addv3(ro, mulv3f(rd, dO));
+        float dS;
+        if (sdfCacheSample(cache, p, &dS) && dS > margin + MIN_DIST) {
+            dO += dS - margin;
+            if (dO > MAX_DIST) break;
+            continue;
+        }
+        dS = sceneDist(p);
+        dO += dS;
+        if (dO > MAX_DIST || dS < MIN_DIST) break;
+    }
+    return dO;
+}
+
+// endregion ------------------- SDF CACHE ---------------
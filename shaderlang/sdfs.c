@@ -57,6 +57,32 @@ float sdTriPrism(vec3 p, vec2 h) {
     return maxf(q.z-h.y,maxf(q.x*0.866025f+p.y*0.5f,-p.y)-h.x*0.5f);
 }
 
+public
+float sdTorus(vec3 p, vec2 t) {
+    vec2 q = v2(lenv2(xzv3(p)) - t.x, p.y);
+    return lenv2(q) - t.y;
+}
+
+public
+float sdCapsule(vec3 p, vec3 a, vec3 b, float r) {
+    vec3 pa = subv3(p, a);
+    vec3 ba = subv3(b, a);
+    float h = clampf(dotv3(pa, ba) / dotv3(ba, ba), 0.0f, 1.0f);
+    return lenv3(subv3(pa, mulv3f(ba, h))) - r;
+}
+
+public
+float sdRoundBox(vec3 p, vec3 b, float r) {
+    return sdBox(p, subv3f(b, r)) - r;
+}
+
+// a bound, not the exact distance: the unit sphere stretched by the radii, scaled by the smallest one
+public
+float sdEllipsoid(vec3 p, vec3 r) {
+    float k = lenv3(divv3(p, r));
+    return (k - 1.0f) * minf(r.x, minf(r.y, r.z));
+}
+
 public
 float opUnion(float d1, float d2) {
     return minf(d1, d2);
@@ -71,3 +97,51 @@ public
 float opIntersection(float d1, float d2) {
     return maxf(d1, d2);
 }
+
+// polynomial smooth minimum: at most k/4 below the hard one
+public
+float opSmoothUnion(float d1, float d2, float k) {
+    float h = maxf(k - absf(d1 - d2), 0.0f) / k;
+    return minf(d1, d2) - h * h * k * 0.25f;
+}
+
+public
+float opSmoothSubtraction(float d1, float d2, float k) {
+    return -opSmoothUnion(d1, -d2, k);
+}
+
+public
+float opSmoothIntersection(float d1, float d2, float k) {
+    return -opSmoothUnion(-d1, -d2, k);
+}
+
+// the coordinate within the nearest copy, c == 0 leaves it alone, l > 0 keeps l copies on either side
+public
+float opRepAxis(float p, float c, float l) {
+    if (c == 0.0f) {
+        return p;
+    }
+    float id = floorf(p / c + 0.5f);
+    if (l > 0.0f) {
+        id = clampf(id, -l, l);
+    }
+    return p - c * id;
+}
+
+// the shape has to fit into its cell for the distance to stay a bound
+public
+vec3 opRep(vec3 p, vec3 c) {
+    return v3(opRepAxis(p.x, c.x, 0.0f), opRepAxis(p.y, c.y, 0.0f), opRepAxis(p.z, c.z, 0.0f));
+}
+
+public
+vec3 opRepLim(vec3 p, vec3 c, vec3 l) {
+    return v3(opRepAxis(p.x, c.x, l.x), opRepAxis(p.y, c.y, l.y), opRepAxis(p.z, c.z, l.z));
+}
+
+// adds displace.x * sin(f * x) * sin(f * y) * sin(f * z), the frequency f is displace.y
+public
+float opDisplace(vec3 p, float d, vec2 displace) {
+    vec3 f = mulv3f(p, displace.y);
+    return d + displace.x * sinf(f.x) * sinf(f.y) * sinf(f.z);
+}
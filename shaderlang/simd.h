@@ -0,0 +1,70 @@
+//
+// Created by greg on 2021-08-23.
+//
+
+// Host only float-native replacements for the double precision detours in math.c,
+// kept out of the translated sources since the shader lexer does not know #if
+
+#pragma once
+
+#include <math.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+// correctly rounded in both cases, so the result is the same bit for bit
+static inline float simdSqrtf(const float value) {
+#if defined(__SSE__)
+    return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(value)));
+#else
+    return (float) sqrt((double) value);
+#endif
+}
+
+static inline float simdFloorf(const float value) {
+#if defined(__SSE4_1__)
+    return _mm_cvtss_f32(_mm_floor_ss(_mm_setzero_ps(), _mm_set_ss(value)));
+#else
+    if (!(value > -8388608.0f && value < 8388608.0f)) {
+        return value; // already integral, inf or nan
+    }
+    const float truncated = (float) (int) value;
+    return truncated > value ? truncated - 1.0f : truncated;
+#endif
+}
+
+// column-major m times (x, y, z, w), one SSE register per column; the scalar path sums in the same order
+static inline void simdTransform(const float *m, const float x, const float y, const float z, const float w,
+                                 float *out) {
+#if defined(__SSE__)
+    __m128 sum = _mm_mul_ps(_mm_loadu_ps(&m[0]), _mm_set1_ps(x));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&m[4]), _mm_set1_ps(y)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&m[8]), _mm_set1_ps(z)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&m[12]), _mm_set1_ps(w)));
+    _mm_storeu_ps(out, sum);
+#else
+    for (int i = 0; i < 4; i++) {
+        out[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i] * w;
+    }
+#endif
+}
+
+// the affine 3x4 part only: the translation column is added, not multiplied
+static inline void simdAffine(const float *m, const float x, const float y, const float z, float *out) {
+#if defined(__SSE__)
+    __m128 sum = _mm_mul_ps(_mm_loadu_ps(&m[0]), _mm_set1_ps(x));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&m[4]), _mm_set1_ps(y)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&m[8]), _mm_set1_ps(z)));
+    sum = _mm_add_ps(sum, _mm_loadu_ps(&m[12]));
+    _mm_storeu_ps(out, sum);
+#else
+    for (int i = 0; i < 4; i++) {
+        out[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+    }
+#endif
+}
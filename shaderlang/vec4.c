@@ -63,7 +63,7 @@ vec4 divv4(const vec4 left, const vec4 right) {
 
 public
 vec4 divv4f(const vec4 left, const float right) {
-    return v4(left.x / right, left.y / right, left.z / right, left.z / right);
+    return v4(left.x / right, left.y / right, left.z / right, left.w / right);
 }
 
 public